@@ -25,7 +25,50 @@ AppConfig::AppConfig()
       redis_host("127.0.0.1"),
       redis_port(6379),
       cache_capacity(1000),
-      cache_ttl(3600) {
+      cache_max_mb(256),
+      cache_compress_cold(true),
+      cache_ttl(3600),
+      shm_cache_enable(false),
+      shm_cache_name("/search_result_cache"),
+      shm_cache_slots(16384),
+      shm_cache_slot_bytes(16384),
+      cache_max_depth(100),
+      coalesce_wait_ms(200),
+      cache_term_invalidation(true),
+      cache_compress(false),
+      cache_negative_ttl(60),
+      cache_max_term_generations(100000),
+      cache_soft_ttl(300),
+      cache_refresh_threads(2),
+      warmup_enable(true),
+      warmup_top_n(1000),
+      warmup_threads(2),
+      warmup_time_limit_ms(30000),
+      redis_pool_size(4),
+      redis_timeout_ms(50),
+      redis_connect_timeout_ms(100),
+      redis_breaker_threshold(5),
+      redis_breaker_cooldown_ms(5000),
+      redis_async_queue(1024),
+      dynamic_merge_factor(10),
+      dynamic_merge_rate(0),
+      dynamic_merge_cpu_percent(50),
+      dynamic_store_text(false),
+      dynamic_compress_docs(true),
+      dynamic_partitions(4),
+      wal_enable(true),
+      wal_sync_interval_ms(5),
+      wal_sync_batch(256),
+      wal_checkpoint_mb(64),
+      ingest_threads(2),
+      ingest_batch_max(512),
+      ingest_queue_max(100000),
+      ingest_wait_timeout_ms(2000),
+      ingest_dedup(true),
+      ingest_dedup_threshold(3),
+      ingest_dedup_mode("reject"),
+      feed_poll_ms(200),
+      feed_batch(512) {
 }
 
 bool loadAppConfig(const std::string &path, AppConfig &cfg) {
@@ -74,9 +117,139 @@ bool loadAppConfig(const std::string &path, AppConfig &cfg) {
         else if (key == "CACHE_CAPACITY") {
             try { cfg.cache_capacity = static_cast<size_t>(std::stoi(val)); } catch (...) {}
         }
+        else if (key == "CACHE_MAX_MB") {
+            try { cfg.cache_max_mb = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "CACHE_COMPRESS_COLD") {
+            cfg.cache_compress_cold = (val == "true" || val == "1" || val == "yes");
+        }
         else if (key == "CACHE_TTL") {
             try { cfg.cache_ttl = std::stoi(val); } catch (...) {}
         }
+        else if (key == "SHM_CACHE_ENABLE") {
+            cfg.shm_cache_enable = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "SHM_CACHE_NAME") cfg.shm_cache_name = val;
+        else if (key == "SHM_CACHE_SLOTS") {
+            try { cfg.shm_cache_slots = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "SHM_CACHE_SLOT_BYTES") {
+            try { cfg.shm_cache_slot_bytes = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "CACHE_MAX_DEPTH") {
+            try { cfg.cache_max_depth = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "COALESCE_WAIT_MS") {
+            try { cfg.coalesce_wait_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "CACHE_TERM_INVALIDATION") {
+            cfg.cache_term_invalidation = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "CACHE_COMPRESS") {
+            cfg.cache_compress = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "CACHE_NEGATIVE_TTL") {
+            try { cfg.cache_negative_ttl = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "CACHE_MAX_TERM_GENERATIONS") {
+            try { cfg.cache_max_term_generations = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "CACHE_SOFT_TTL") {
+            try { cfg.cache_soft_ttl = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "CACHE_REFRESH_THREADS") {
+            try { cfg.cache_refresh_threads = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "WARMUP_ENABLE") {
+            cfg.warmup_enable = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "QUERY_LOG_PATH") cfg.query_log_path = val;
+        else if (key == "WARMUP_TOP_N") {
+            try { cfg.warmup_top_n = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "WARMUP_THREADS") {
+            try { cfg.warmup_threads = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "WARMUP_TIME_LIMIT_MS") {
+            try { cfg.warmup_time_limit_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "REDIS_POOL_SIZE") {
+            try { cfg.redis_pool_size = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "REDIS_TIMEOUT_MS") {
+            try { cfg.redis_timeout_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "REDIS_CONNECT_TIMEOUT_MS") {
+            try { cfg.redis_connect_timeout_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "REDIS_BREAKER_THRESHOLD") {
+            try { cfg.redis_breaker_threshold = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "REDIS_BREAKER_COOLDOWN_MS") {
+            try { cfg.redis_breaker_cooldown_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "REDIS_ASYNC_QUEUE") {
+            try { cfg.redis_async_queue = static_cast<size_t>(std::stoi(val)); } catch (...) {}
+        }
+        else if (key == "DYNAMIC_MERGE_FACTOR") {
+            try { cfg.dynamic_merge_factor = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "DYNAMIC_MERGE_RATE") {
+            try { cfg.dynamic_merge_rate = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "DYNAMIC_MERGE_CPU_PERCENT") {
+            try { cfg.dynamic_merge_cpu_percent = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "DYNAMIC_STORE_TEXT") {
+            cfg.dynamic_store_text = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "DYNAMIC_COMPRESS_DOCS") {
+            cfg.dynamic_compress_docs = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "DYNAMIC_PARTITIONS") {
+            try { cfg.dynamic_partitions = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "WAL_ENABLE") {
+            cfg.wal_enable = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "WAL_PATH") cfg.wal_path = val;
+        else if (key == "DOCID_MAP_PATH") cfg.docid_map_path = val;
+        else if (key == "WAL_SYNC_INTERVAL_MS") {
+            try { cfg.wal_sync_interval_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "WAL_SYNC_BATCH") {
+            try { cfg.wal_sync_batch = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "WAL_CHECKPOINT_MB") {
+            try { cfg.wal_checkpoint_mb = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "INGEST_THREADS") {
+            try { cfg.ingest_threads = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "INGEST_BATCH_MAX") {
+            try { cfg.ingest_batch_max = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "INGEST_QUEUE_MAX") {
+            try { cfg.ingest_queue_max = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
+        else if (key == "INGEST_WAIT_TIMEOUT_MS") {
+            try { cfg.ingest_wait_timeout_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "INGEST_DEDUP") {
+            cfg.ingest_dedup = (val == "true" || val == "1" || val == "yes");
+        }
+        else if (key == "INGEST_DEDUP_THRESHOLD") {
+            try { cfg.ingest_dedup_threshold = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "INGEST_DEDUP_MODE") cfg.ingest_dedup_mode = val;
+        else if (key == "FEED_PATH") cfg.feed_path = val;
+        else if (key == "FEED_OFFSET_PATH") cfg.feed_offset_path = val;
+        else if (key == "FEED_POLL_MS") {
+            try { cfg.feed_poll_ms = std::stoi(val); } catch (...) {}
+        }
+        else if (key == "FEED_BATCH") {
+            try { cfg.feed_batch = static_cast<size_t>(std::stoul(val)); } catch (...) {}
+        }
     }
     return true;
 }
@@ -32,7 +32,55 @@ struct AppConfig {
     std::string redis_host;          // Redis 服务器地址
     int redis_port;                  // Redis 服务器端口
     size_t cache_capacity;           // 本地 LRU 缓存容量
+    size_t cache_max_mb;             // 本地缓存字节预算（MB，0 不限）
+    bool cache_compress_cold;        // 冷条目编码（LZ4）保存
     int cache_ttl;                   // Redis 缓存 TTL（秒）
+    bool shm_cache_enable;           // 启用共享内存缓存层
+    std::string shm_cache_name;      // shm_open 名称
+    size_t shm_cache_slots;          // 共享内存槽位数
+    size_t shm_cache_slot_bytes;     // 单槽位字节数
+    size_t cache_max_depth;          // 每条缓存保存的结果深度
+    int coalesce_wait_ms;            // 并发相同查询合并的最长等待（毫秒，0 关闭）
+    bool cache_term_invalidation;    // 索引写入时只失效包含相关词的缓存
+    bool cache_compress;             // Redis 缓存值是否 LZ4 压缩（需 ENABLE_LZ4=1 编译）
+    int cache_negative_ttl;          // 零结果查询的缓存 TTL（秒，0 不缓存）
+    size_t cache_max_term_generations;  // 词代数表上限，超过后折叠为一次全局失效（0 不限）
+    int cache_soft_ttl;              // 软 TTL（秒），超过后返回旧结果并后台刷新（0 关闭）
+    size_t cache_refresh_threads;    // 后台刷新线程数
+    bool warmup_enable;              // 启动时按查询日志预热缓存
+    std::string query_log_path;      // 查询日志文件（空则为 index_dir/query_log.txt）
+    size_t warmup_top_n;             // 预热重放的查询数
+    size_t warmup_threads;           // 预热并发线程数
+    int warmup_time_limit_ms;        // 预热总时长上限（毫秒）
+    size_t redis_pool_size;          // Redis 读连接池大小
+    int redis_timeout_ms;            // Redis 单条命令超时（毫秒）
+    int redis_connect_timeout_ms;    // Redis 建连超时（毫秒）
+    int redis_breaker_threshold;     // 连续失败多少次后熔断
+    int redis_breaker_cooldown_ms;   // 熔断持续时间（毫秒）
+    size_t redis_async_queue;        // 异步写队列上限
+    size_t dynamic_merge_factor;     // 同层段数达到该值时合并
+    size_t dynamic_merge_rate;       // 合并速率上限（倒排项/秒，0 不限）
+    int dynamic_merge_cpu_percent;   // 合并线程 CPU 占用上限（百分比）
+    bool dynamic_store_text;         // 动态文档元数据是否保留全文
+    bool dynamic_compress_docs;      // 动态文档元数据 LZ4 压缩（需 ENABLE_LZ4=1 编译）
+    size_t dynamic_partitions;       // 动态索引分区数（各分区独立写锁，批量写入并行应用）
+    bool wal_enable;                 // 动态索引写入预写日志
+    std::string wal_path;            // WAL 文件（空则为 index_dir/dynamic_index.wal）
+    int wal_sync_interval_ms;        // 组提交最长间隔（毫秒）
+    size_t wal_sync_batch;           // 组提交批量条数
+    size_t wal_checkpoint_mb;        // WAL 增长超过该值（MB）时自动检查点（0 关闭）
+    std::string docid_map_path;      // 外部 docid 映射文件（空则为 index_dir/docid_map.txt）
+    size_t ingest_threads;           // 写入队列分词线程数
+    size_t ingest_batch_max;         // 写入微批次最大请求数
+    size_t ingest_queue_max;         // 未应用写入请求上限（超过返回 429）
+    int ingest_wait_timeout_ms;      // wait_for_seq 最长等待（毫秒）
+    bool ingest_dedup;               // 写入时拒绝与已索引文档近重复的新文档（SimHash）
+    int ingest_dedup_threshold;      // 近重复的汉明距离阈值
+    std::string ingest_dedup_mode;   // reject（丢弃新文档）或 replace（删除已有文档）
+    std::string feed_path;           // 追加写 JSONL 写入源（空则关闭）
+    std::string feed_offset_path;    // 写入源偏移量文件（空则为 feed_path.offset）
+    int feed_poll_ms;                // 没有新数据时的轮询间隔（毫秒）
+    size_t feed_batch;               // 写入源每批提交的记录数
     
     AppConfig();
 };
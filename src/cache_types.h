@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// 搜索缓存配置
+struct CacheOptions {
+    // Redis 连接
+    std::string redis_host = "127.0.0.1";
+    int redis_port = 6379;
+    size_t redis_pool_size = 4;            // 读连接池大小
+    int redis_timeout_ms = 50;             // 单条命令超时（毫秒）
+    int redis_connect_timeout_ms = 100;    // 建连超时（毫秒）
+    int redis_breaker_threshold = 5;       // 连续失败多少次后熔断
+    int redis_breaker_cooldown_ms = 5000;  // 熔断持续时间（毫秒）
+    size_t redis_async_queue = 1024;       // 异步写队列上限
+
+    // 本地 LRU：条目数上限与字节预算（0 表示不限字节，只按条目数）
+    size_t local_capacity = 1000;
+    size_t local_max_bytes = 0;
+    // LRU 较冷的一半以编码（可选 LZ4）形式保存，命中时解码并提升
+    bool compress_cold = false;
+
+    // 同主机多进程共享的内存缓存层（位于本地 LRU 与 Redis 之间）
+    bool shm_enable = false;
+    std::string shm_name = "/search_result_cache";
+    size_t shm_slots = 16384;
+    size_t shm_slot_bytes = 16384;
+
+    // 每条缓存保存的结果深度，top_k 不超过该值的查询截取复用
+    size_t max_depth = 100;
+
+    // Redis 缓存 TTL（秒）与编码
+    int cache_ttl = 3600;
+    bool compress = false;
+
+    // 零结果查询的缓存 TTL（秒），0 表示不缓存零结果
+    int negative_ttl = 60;
+
+    // 词代数表的上限：超过后全局代数 +1 并清空词代数（本地与 Redis），0 表示不限
+    size_t max_term_generations = 100000;
+
+    // 软 TTL（秒）：超过后仍返回旧结果，同时后台刷新；0 表示关闭
+    int soft_ttl = 300;
+    size_t refresh_threads = 2;  // 后台刷新线程数
+};
+
+// 缓存查询结果
+enum class CacheLookup {
+    Miss,   // 未命中
+    Fresh,  // 命中且未过软 TTL
+    Stale   // 命中但已过软 TTL，应后台刷新
+};
+
+// 缓存统计
+struct CacheStats {
+    size_t local_hits = 0;
+    size_t redis_hits = 0;
+    size_t shm_hits = 0;        // 共享内存层命中
+    size_t misses = 0;
+    size_t local_size = 0;
+    size_t local_bytes = 0;     // 本地缓存占用字节（估算含容器开销）
+    size_t local_cold = 0;      // 以编码形式保存的冷条目数
+    size_t negative_hits = 0;   // 命中零结果缓存
+    size_t stale_hits = 0;      // 命中过期（软 TTL）条目
+    size_t refreshes = 0;       // 后台刷新次数
+
+    // Redis 健康状况
+    size_t redis_errors = 0;
+    size_t redis_rejected = 0;
+    size_t redis_dropped_puts = 0;
+    bool redis_breaker_open = false;
+
+    // 并发相同查询合并（single-flight）
+    size_t coalesce_leaders = 0;   // 实际执行搜索的请求
+    size_t coalesced = 0;          // 复用领头请求结果的请求
+    size_t coalesce_timeouts = 0;  // 等待超时后自行计算的请求
+};
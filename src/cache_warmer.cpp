@@ -0,0 +1,159 @@
+#include "cache_warmer.h"
+#include "search_engine.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+
+namespace {
+    std::string joinTerms(std::vector<std::string> terms) {
+        // 与 SearchEngine 的缓存 key 一致：排序去重，词序不同的查询合并计数
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        std::string key;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            if (i > 0) key.push_back(' ');
+            key += terms[i];
+        }
+        return key;
+    }
+
+    std::vector<std::string> splitTerms(const std::string &key) {
+        std::vector<std::string> terms;
+        std::istringstream iss(key);
+        std::string t;
+        while (iss >> t) terms.push_back(t);
+        return terms;
+    }
+
+    using Entry = std::pair<std::string, size_t>;
+
+    void sortByCount(std::vector<Entry> &entries) {
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+    }
+}
+
+QueryLog::QueryLog(size_t max_entries) : max_entries_(std::max<size_t>(max_entries, 1)) {}
+
+void QueryLog::record(const std::vector<std::string> &terms) {
+    std::string key = joinTerms(terms);
+    if (key.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    counts_[key]++;
+    // 允许超出一倍再批量裁剪，避免每次记录都排序
+    if (counts_.size() > 2 * max_entries_) pruneLocked();
+}
+
+void QueryLog::pruneLocked() {
+    std::vector<Entry> entries(counts_.begin(), counts_.end());
+    sortByCount(entries);
+    if (entries.size() > max_entries_) entries.resize(max_entries_);
+    counts_ = std::unordered_map<std::string, size_t>(entries.begin(), entries.end());
+}
+
+std::vector<std::vector<std::string>> QueryLog::top(size_t n) const {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.assign(counts_.begin(), counts_.end());
+    }
+    sortByCount(entries);
+    if (entries.size() > n) entries.resize(n);
+
+    std::vector<std::vector<std::string>> out;
+    out.reserve(entries.size());
+    for (const auto &e : entries) out.push_back(splitTerms(e.first));
+    return out;
+}
+
+bool QueryLog::load(const std::string &path) {
+    std::ifstream fin(path);
+    if (!fin) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string line;
+    while (std::getline(fin, line)) {
+        auto tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        try {
+            size_t count = static_cast<size_t>(std::stoull(line.substr(0, tab)));
+            std::string key = line.substr(tab + 1);
+            if (!key.empty()) counts_[key] += count;
+        } catch (...) {}
+    }
+    if (counts_.size() > max_entries_) pruneLocked();
+    return true;
+}
+
+bool QueryLog::save(const std::string &path) const {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.assign(counts_.begin(), counts_.end());
+    }
+    sortByCount(entries);
+    if (entries.size() > max_entries_) entries.resize(max_entries_);
+
+    // 先写临时文件再改名，避免停机中断留下半个文件
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream fout(tmp, std::ios::trunc);
+        if (!fout) return false;
+        for (const auto &e : entries) fout << e.second << '\t' << e.first << '\n';
+        if (!fout) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+CacheWarmer::CacheWarmer(SearchEngine &engine, const Options &opts) : engine_(engine), opts_(opts) {
+    if (opts_.threads == 0) opts_.threads = 1;
+}
+
+CacheWarmer::~CacheWarmer() {
+    stopping_ = true;
+    if (runner_.joinable()) runner_.join();
+}
+
+void CacheWarmer::start(std::vector<std::vector<std::string>> queries) {
+    if (queries.empty() || runner_.joinable()) return;
+    ready_ = false;
+    total_ = queries.size();
+    runner_ = std::thread(&CacheWarmer::run, this, std::move(queries));
+}
+
+void CacheWarmer::run(std::vector<std::vector<std::string>> queries) {
+    auto start_time = std::chrono::steady_clock::now();
+    auto deadline = start_time + std::chrono::milliseconds(opts_.time_limit_ms);
+    std::atomic<size_t> skipped{0};
+
+    {
+        // 线程池析构时等待所有任务完成；超时后任务直接跳过
+        ThreadPool pool(opts_.threads);
+        for (auto &terms : queries) {
+            pool.enqueue([this, &skipped, deadline, terms = std::move(terms)]() {
+                if (stopping_ || std::chrono::steady_clock::now() >= deadline) {
+                    skipped++;
+                    return;
+                }
+                try {
+                    engine_.queryRanked(terms, opts_.top_k);
+                    warmed_++;
+                } catch (const std::exception &e) {
+                    std::cerr << "[WARMUP] query failed: " << e.what() << std::endl;
+                }
+            });
+        }
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "✓ Cache warm-up finished: " << warmed_.load() << "/" << total_.load()
+              << " queries in " << duration << "ms";
+    if (skipped.load() > 0) std::cout << " (" << skipped.load() << " skipped, time limit reached)";
+    std::cout << std::endl;
+    ready_ = true;
+}
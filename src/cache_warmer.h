@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+class SearchEngine;
+
+// 查询日志：记录规范化查询（排序去重后的词）及其次数，停机时持久化
+// 文件格式：每行 "<次数>\t<词1 词2 ...>"，按次数降序
+class QueryLog {
+public:
+    explicit QueryLog(size_t max_entries = 10000);
+
+    // 记录一次查询
+    void record(const std::vector<std::string> &terms);
+
+    // 次数最多的 n 条查询（每条为规范化后的词列表）
+    std::vector<std::vector<std::string>> top(size_t n) const;
+
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+
+private:
+    // 超过上限时只保留次数最高的 max_entries_ 条（调用方持有 mutex_）
+    void pruneLocked();
+
+    size_t max_entries_;
+    std::unordered_map<std::string, size_t> counts_;
+    mutable std::mutex mutex_;
+};
+
+// 启动预热：在后台线程池上重放热门查询，填充本地缓存
+// 预热期间 ready() 为 false，/health 据此返回 503
+class CacheWarmer {
+public:
+    struct Options {
+        size_t threads = 2;          // 预热并发数（限制 CPU 占用）
+        int time_limit_ms = 30000;   // 预热总时长上限，超时后放弃剩余查询
+        size_t top_k = 20;           // 重放时的 top_k
+    };
+
+    CacheWarmer(SearchEngine &engine, const Options &opts);
+    ~CacheWarmer();
+
+    CacheWarmer(const CacheWarmer&) = delete;
+    CacheWarmer& operator=(const CacheWarmer&) = delete;
+
+    // 异步开始预热，立即返回
+    void start(std::vector<std::vector<std::string>> queries);
+
+    bool ready() const { return ready_.load(); }
+    size_t total() const { return total_.load(); }
+    size_t warmed() const { return warmed_.load(); }
+
+private:
+    void run(std::vector<std::vector<std::string>> queries);
+
+    SearchEngine &engine_;
+    Options opts_;
+    std::thread runner_;
+    std::atomic<bool> ready_{true};
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> total_{0};
+    std::atomic<size_t> warmed_{0};
+};
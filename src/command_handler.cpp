@@ -9,6 +9,7 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
 
 using json = nlohmann::json;
 
@@ -39,6 +40,8 @@ int BuildIndexCommand::execute() {
         std::cout << "No XML files found in " << config_.input_dir << "\n";
         return 1;
     }
+    // 目录遍历顺序不确定；按文件名排序，保证多次构建的网页顺序与 docid 一致
+    std::sort(xmls.begin(), xmls.end());
     
     // 运行离线流水线
     OfflinePipeline pipeline;
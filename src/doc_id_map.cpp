@@ -0,0 +1,191 @@
+#include "doc_id_map.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    bool writeAll(int fd, const std::string &data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool validKey(const std::string &key) {
+        return !key.empty() && key.find('\n') == std::string::npos;
+    }
+}
+
+DocIdMap::~DocIdMap() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool DocIdMap::open(const std::string &path, uint32_t base_limit) {
+    path_ = path;
+    base_limit_ = base_limit;
+    if (path.empty()) return true;
+
+    // 读取已有映射：首行基础区间，之后每行一个 key；不完整的尾行丢弃
+    std::vector<std::string> keys;
+    uint32_t stored_base = base_limit;
+    bool exists = false;
+    uint64_t valid_bytes = 0;
+    {
+        std::ifstream fin(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+        exists = fin.is_open() && !content.empty();
+        size_t pos = 0;
+        size_t newline;
+        bool header = true;
+        while ((newline = content.find('\n', pos)) != std::string::npos) {
+            std::string line = content.substr(pos, newline - pos);
+            pos = newline + 1;
+            if (header) {
+                header = false;
+                if (line.compare(0, 5, "base ") != 0) {
+                    std::cerr << "✗ Invalid docid map header in " << path << std::endl;
+                    return false;
+                }
+                try { stored_base = static_cast<uint32_t>(std::stoul(line.substr(5))); } catch (...) { return false; }
+            } else {
+                keys.push_back(std::move(line));
+            }
+            valid_bytes = pos;
+        }
+        if (exists && header) exists = false;  // 连首行都不完整，视为新文件
+    }
+
+    if (exists && !keys.empty()) {
+        // 已有分配时沿用原基础区间，保证内部 ID 稳定
+        if (base_limit > stored_base) {
+            std::cerr << "⚠ Base index grew past the docid map range (" << stored_base << " -> " << base_limit
+                      << "), base docs >= " << stored_base << " conflict with dynamic ids" << std::endl;
+        }
+        base_limit_ = stored_base;
+    } else {
+        exists = false;
+    }
+
+    if (!exists) {
+        // 新建（或只有首行时按新的基础区间重写）：临时文件 + rename
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        std::string header = "base " + std::to_string(base_limit_) + "\n";
+        bool ok = writeAll(fd, header) && ::fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) return false;
+        keys.clear();
+        valid_bytes = header.size();
+    } else if (::truncate(path.c_str(), static_cast<off_t>(valid_bytes)) != 0) {
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd_ < 0) return false;
+    bytes_ = valid_bytes;
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    keys_ = std::move(keys);
+    ids_.clear();
+    ids_.reserve(keys_.size());
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        ids_.emplace(keys_[i], static_cast<uint32_t>(base_limit_ + i));
+    }
+    return true;
+}
+
+bool DocIdMap::baseId(const std::string &key, uint32_t &id) const {
+    if (key.empty() || key.size() > 10 || (key.size() > 1 && key[0] == '0')) return false;
+    uint64_t value = 0;
+    for (char c : key) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (value >= base_limit_) return false;
+    id = static_cast<uint32_t>(value);
+    return true;
+}
+
+bool DocIdMap::find(const std::string &key, uint32_t &id) const {
+    if (baseId(key, id)) return true;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(key);
+    if (it == ids_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+bool DocIdMap::assign(const std::vector<std::string> &keys, std::vector<uint32_t> &ids) {
+    for (const auto &key : keys) {
+        if (!validKey(key)) return false;
+    }
+    ids.assign(keys.size(), 0);
+
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    // 分配只在 write_mutex_ 下进行，这里读到的就是最新状态
+    std::vector<std::string> added;
+    std::unordered_map<std::string, uint32_t> pending;
+    uint32_t next = static_cast<uint32_t>(base_limit_ + keys_.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (find(keys[i], ids[i])) continue;
+        auto [it, inserted] = pending.emplace(keys[i], next);
+        if (inserted) {
+            added.push_back(keys[i]);
+            next++;
+        }
+        ids[i] = it->second;
+    }
+    if (added.empty()) return true;
+
+    // 先落盘再发布，失败时整批不分配
+    if (broken_) return false;
+    if (fd_ >= 0) {
+        std::string data;
+        for (const auto &key : added) {
+            data += key;
+            data.push_back('\n');
+        }
+        if (!writeAll(fd_, data) || ::fdatasync(fd_) != 0) {
+            std::cerr << "✗ Failed to persist docid map " << path_ << std::endl;
+            // 行号即 ID：截掉本批可能已写入的行，否则重启后之后分配的 ID 都会错位
+            if (::ftruncate(fd_, static_cast<off_t>(bytes_)) != 0) {
+                std::cerr << "✗ Failed to roll back docid map " << path_ << ", refusing further assignments" << std::endl;
+                broken_ = true;
+            }
+            return false;
+        }
+        bytes_ += data.size();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto &key : added) {
+        ids_.emplace(key, static_cast<uint32_t>(base_limit_ + keys_.size()));
+        keys_.push_back(std::move(key));
+    }
+    return true;
+}
+
+bool DocIdMap::assign(const std::string &key, uint32_t &id) {
+    std::vector<uint32_t> ids;
+    if (!assign(std::vector<std::string>{key}, ids)) return false;
+    id = ids[0];
+    return true;
+}
+
+std::string DocIdMap::key(uint32_t id) const {
+    if (id < base_limit_) return std::to_string(id);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t index = id - base_limit_;
+    return index < keys_.size() ? keys_[index] : std::string();
+}
+
+size_t DocIdMap::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return base_limit_ + keys_.size();
+}
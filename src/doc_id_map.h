@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+// 外部文档 ID -> 稠密内部 ID 的映射
+//
+// - 内部 ID 为从 0 开始连续分配的 uint32，每文档结构都可以用平坦数组按 ID 下标访问
+// - 基础索引的 docid（离线流水线按序分配）直接作为内部 ID：[0, base_limit) 内的
+//   十进制整数 key 映射到自身，不占存储
+// - 其余外部 ID（任意字符串，如文件 MD5，或超出基础区间的整数）按首次出现的顺序
+//   从 base_limit 起分配
+// - 持久化为索引目录下的文本文件：首行 "base <base_limit>"，之后每行一个 key，
+//   行号即分配顺序；新分配的 key 追加并 fdatasync 后才返回，
+//   引用该 ID 的 WAL 记录一定晚于映射落盘；落盘失败时截断回写入前的长度，整批不分配
+class DocIdMap {
+public:
+    DocIdMap() = default;
+    ~DocIdMap();
+
+    DocIdMap(const DocIdMap&) = delete;
+    DocIdMap& operator=(const DocIdMap&) = delete;
+
+    // 打开（不存在则创建）映射文件；base_limit 为基础索引最大 docid + 1。
+    // path 为空时只在内存中分配
+    bool open(const std::string &path, uint32_t base_limit);
+
+    // 查找已有的内部 ID
+    bool find(const std::string &key, uint32_t &id) const;
+
+    // 查找或分配；整批新 key 只落盘一次。key 为空或含换行时该批失败
+    bool assign(const std::vector<std::string> &keys, std::vector<uint32_t> &ids);
+    bool assign(const std::string &key, uint32_t &id);
+
+    // 内部 ID 对应的外部 ID（未分配时返回空串）
+    std::string key(uint32_t id) const;
+
+    uint32_t baseLimit() const { return base_limit_; }
+
+    // 已分配的内部 ID 总数（含基础区间）
+    size_t size() const;
+
+private:
+    // [0, base_limit_) 内无前导零的十进制整数
+    bool baseId(const std::string &key, uint32_t &id) const;
+
+    std::string path_;
+    int fd_ = -1;
+    uint32_t base_limit_ = 0;
+
+    std::mutex write_mutex_;          // 串行化分配与落盘
+    uint64_t bytes_ = 0;              // 已落盘的文件长度，写入失败时截断回该位置
+    bool broken_ = false;             // 截断也失败：文件内容与内存不一致，拒绝再分配
+    mutable std::shared_mutex mutex_; // 保护下面两个表，读者只取共享锁
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<std::string> keys_;   // 下标 + base_limit_ 为内部 ID
+};
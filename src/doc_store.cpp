@@ -0,0 +1,136 @@
+#include "doc_store.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#ifdef SEARCH_CACHE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+    // 块表定长，追加新块时读者无需同步；默认 1MB 一块时上限 64GB
+    constexpr uint32_t kMaxBlocks = 1u << 16;
+}
+
+DocStore::DocStore(const Options &opts)
+    : opts_(opts), blocks_(new std::atomic<char*>[kMaxBlocks]()) {
+    if (opts_.block_bytes < 4096) opts_.block_bytes = 4096;
+}
+
+DocStore::~DocStore() {
+    for (uint32_t i = 0; i < block_count_; ++i) {
+        delete[] blocks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+DocStore::Handle DocStore::append(std::string_view data, size_t logical_bytes) {
+    const char *payload = data.data();
+    size_t payload_len = data.size();
+    uint32_t raw_len = 0;
+
+#ifdef SEARCH_CACHE_LZ4
+    // 压缩在追加锁外完成
+    std::string packed;
+    if (opts_.compress && data.size() >= opts_.compress_min_bytes &&
+        data.size() <= static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        int bound = LZ4_compressBound(static_cast<int>(data.size()));
+        packed.resize(static_cast<size_t>(bound));
+        int n = LZ4_compress_default(data.data(), &packed[0], static_cast<int>(data.size()), bound);
+        if (n > 0 && static_cast<size_t>(n) < data.size()) {
+            payload = packed.data();
+            payload_len = static_cast<size_t>(n);
+            raw_len = static_cast<uint32_t>(data.size());
+        }
+    }
+#endif
+
+    return appendStored(std::string_view(payload, payload_len), raw_len, logical_bytes);
+}
+
+DocStore::Handle DocStore::appendStored(std::string_view stored, uint32_t raw_len, size_t logical_bytes) {
+    const char *payload = stored.data();
+    const size_t payload_len = stored.size();
+    const size_t need = sizeof(RecordHeader) + payload_len;
+    if (need > UINT32_MAX) return 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (block_count_ == 0 || block_used_ + need > block_size_) {
+        if (block_count_ >= kMaxBlocks) return 0;
+        size_t size = std::max(opts_.block_bytes, need);
+        blocks_[block_count_].store(new char[size], std::memory_order_release);
+        block_count_++;
+        block_size_ = size;
+        block_used_ = 0;
+        arena_bytes_ += size;
+    }
+
+    char *dst = blocks_[block_count_ - 1].load(std::memory_order_relaxed) + block_used_;
+    RecordHeader header{static_cast<uint32_t>(payload_len), raw_len,
+                        static_cast<uint32_t>(std::min<size_t>(logical_bytes, UINT32_MAX))};
+    std::memcpy(dst, &header, sizeof(header));
+    std::memcpy(dst + sizeof(header), payload, payload_len);
+
+    Handle handle = (static_cast<uint64_t>(block_count_) << 32) | block_used_;
+    block_used_ += need;
+
+    records_++;
+    logical_bytes_ += header.logical_bytes;
+    raw_bytes_ += raw_len ? raw_len : payload_len;
+    stored_bytes_ += need;
+    return handle;
+}
+
+const char *DocStore::locate(Handle handle, RecordHeader &header) const {
+    uint64_t block = handle >> 32;
+    if (block == 0 || block > kMaxBlocks) return nullptr;
+    const char *base = blocks_[block - 1].load(std::memory_order_acquire);
+    if (!base) return nullptr;
+    const char *record = base + static_cast<uint32_t>(handle);
+    std::memcpy(&header, record, sizeof(header));
+    return record + sizeof(header);
+}
+
+bool DocStore::read(Handle handle, std::string &out) const {
+    RecordHeader header;
+    const char *payload = locate(handle, header);
+    if (!payload) return false;
+
+    if (header.raw_len == 0) {
+        out.assign(payload, header.stored_len);
+        return true;
+    }
+#ifdef SEARCH_CACHE_LZ4
+    out.resize(header.raw_len);
+    int n = LZ4_decompress_safe(payload, &out[0], static_cast<int>(header.stored_len),
+                                static_cast<int>(header.raw_len));
+    return n >= 0 && static_cast<uint32_t>(n) == header.raw_len;
+#else
+    return false;
+#endif
+}
+
+bool DocStore::readStored(Handle handle, std::string_view &stored, uint32_t &raw_len,
+                          uint32_t &logical_bytes) const {
+    RecordHeader header;
+    const char *payload = locate(handle, header);
+    if (!payload) return false;
+    stored = std::string_view(payload, header.stored_len);
+    raw_len = header.raw_len;
+    logical_bytes = header.logical_bytes;
+    return true;
+}
+
+void DocStore::release(Handle handle) {
+    RecordHeader header;
+    if (!locate(handle, header)) return;
+    uint64_t stored = sizeof(header) + header.stored_len;
+    records_--;
+    logical_bytes_ -= header.logical_bytes;
+    raw_bytes_ -= header.raw_len ? header.raw_len : header.stored_len;
+    stored_bytes_ -= stored;
+    dead_bytes_ += stored;
+}
+
+DocStore::Stats DocStore::getStats() const {
+    return {records_.load(), logical_bytes_.load(), raw_bytes_.load(),
+            stored_bytes_.load(), arena_bytes_.load(), dead_bytes_.load()};
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// 只追加的文档记录存储（分块 arena）
+//
+// - 记录依次追加到固定大小的内存块中，不逐条分配；超过块大小的记录独占一块
+// - 记录格式：[u32 存储长度][u32 原始长度（0 表示未压缩）][u32 逻辑字节数][数据]
+// - 可选 LZ4 压缩（ENABLE_LZ4=1 编译时生效），压缩后没有变小则保留原文
+// - 追加与读取可并发：块表是定长原子指针数组，读者无需加锁；
+//   句柄需经由带同步的途径（如发布快照）交给读者
+// - 记录不会被覆盖或回收，release 只统计失效字节（进程重启后从检查点重建时回收）
+class DocStore {
+public:
+    struct Options {
+        bool compress = true;            // 是否 LZ4 压缩
+        size_t compress_min_bytes = 128; // 小于该长度的记录不压缩
+        size_t block_bytes = 1 << 20;    // 每块大小
+    };
+
+    // 句柄：高 32 位为块号 + 1，低 32 位为块内偏移；0 表示无记录
+    using Handle = uint64_t;
+
+    struct Stats {
+        size_t records;          // 存活记录数
+        uint64_t logical_bytes;  // 存活记录按调用方原有结构估算的内存
+        uint64_t raw_bytes;      // 存活记录未压缩时的长度
+        uint64_t stored_bytes;   // 存活记录实际占用（含记录头）
+        uint64_t arena_bytes;    // 已分配的块总大小
+        uint64_t dead_bytes;     // 已失效但未回收的字节
+    };
+
+    DocStore() : DocStore(Options()) {}
+    explicit DocStore(const Options &opts);
+    ~DocStore();
+
+    DocStore(const DocStore&) = delete;
+    DocStore& operator=(const DocStore&) = delete;
+
+    // 追加一条记录；logical_bytes 为调用方用原有结构保存该记录时的估算内存（仅用于统计）
+    Handle append(std::string_view data, size_t logical_bytes);
+
+    // 读取记录原文，句柄无效或数据损坏时返回 false
+    bool read(Handle handle, std::string &out) const;
+
+    // 按存储形式（可能是压缩数据）导出/导入记录，供检查点使用，不解压也不重新压缩；
+    // raw_len 为 0 表示未压缩
+    bool readStored(Handle handle, std::string_view &stored, uint32_t &raw_len, uint32_t &logical_bytes) const;
+    Handle appendStored(std::string_view stored, uint32_t raw_len, size_t logical_bytes);
+
+    // 标记记录失效（只更新统计）
+    void release(Handle handle);
+
+    Stats getStats() const;
+
+private:
+    struct RecordHeader {
+        uint32_t stored_len;
+        uint32_t raw_len;
+        uint32_t logical_bytes;
+    };
+
+    const char *locate(Handle handle, RecordHeader &header) const;
+
+    Options opts_;
+
+    std::mutex mutex_;  // 串行化追加
+    std::unique_ptr<std::atomic<char*>[]> blocks_;
+    uint32_t block_count_ = 0;
+    size_t block_size_ = 0;   // 当前块大小
+    size_t block_used_ = 0;   // 当前块已用字节
+
+    std::atomic<size_t> records_{0};
+    std::atomic<uint64_t> logical_bytes_{0};
+    std::atomic<uint64_t> raw_bytes_{0};
+    std::atomic<uint64_t> stored_bytes_{0};
+    std::atomic<uint64_t> arena_bytes_{0};
+    std::atomic<uint64_t> dead_bytes_{0};
+};
@@ -1,290 +1,1596 @@
 #include "dynamic_index.h"
 #include "tokenizer.h"
+#include "thread_pool.h"
 #include <cmath>
 #include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <iostream>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-bool DynamicInvertedIndex::loadFromFile(const std::string &index_path, size_t total_docs_count) {
-    std::unique_lock lock(mutex_);
-    
-    std::ifstream ifs(index_path);
-    if (!ifs) return false;
-    
-    postings_.clear();
-    total_docs_ = total_docs_count;
-    
-    std::string line;
-    while (std::getline(ifs, line)) {
-        std::istringstream iss(line);
-        std::string term;
-        iss >> term;
-        
-        int docid;
-        double weight;
-        while (iss >> docid >> weight) {
-            postings_[term].insert({docid, weight});
+namespace {
+    // 与 WeightedInvertedIndex 一致的平滑 IDF，单文档索引中权重也不为 0
+    inline double smoothIdf(size_t n, size_t df) {
+        return std::log((static_cast<double>(n) + 1.0) / (static_cast<double>(df) + 1.0)) + 1.0;
+    }
+
+    // std::string 的估算占用：对象本身 + 超出短字符串优化部分的堆内存
+    inline size_t stringBytes(const std::string &s) {
+        return sizeof(std::string) + (s.size() > 15 ? s.size() + 1 : 0);
+    }
+
+    void putStr(std::string &out, const std::string &s) {
+        uint32_t len = static_cast<uint32_t>(s.size());
+        out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        out += s;
+    }
+
+    bool getStr(std::string_view &in, std::string &s) {
+        uint32_t len;
+        if (in.size() < sizeof(len)) return false;
+        std::memcpy(&len, in.data(), sizeof(len));
+        in.remove_prefix(sizeof(len));
+        if (in.size() < len) return false;
+        s.assign(in.data(), len);
+        in.remove_prefix(len);
+        return true;
+    }
+
+    DocStore::Options docStoreOptions(const DynamicInvertedIndex::Options &opts) {
+        DocStore::Options store_opts;
+        store_opts.compress = opts.compress_docs;
+        return store_opts;
+    }
+
+    // 检查点文件（小端，定长字段直接按内存布局写入）：
+    //   [magic 8][u32 版本][u64 之后的第一代日志]
+    //   [u32 n][i32 被屏蔽的基础 docid * n]
+    //   [u32 段数]，每段：
+    //     [u64 段 ID][u32 文档数][i32 docid * 文档数][u32 位图字数][u64 * 字数]
+    //     每文档：[u32 存储长度（kNoMeta 表示无元数据）][u32 原始长度][u32 逻辑字节数][数据]
+    //     [u32 词数]，每词：[u32 长度][词][u32 n][(u32 序号, f64 TF) * n]
+    //   [u64 此前的字节数][u32 此前所有字节的 CRC32][结束 magic 8]
+    // 元数据按 DocStore 的存储形式保存，加载时不解压、不重新压缩
+    constexpr char kCheckpointMagic[8] = {'D', 'I', 'X', 'C', 'K', 'P', 'T', '1'};
+    constexpr char kCheckpointEnd[8] = {'D', 'I', 'X', 'E', 'N', 'D', '\0', '\0'};
+    constexpr uint32_t kCheckpointVersion = 2;
+    constexpr uint32_t kNoMeta = 0xFFFFFFFFu;
+
+    // 带缓冲的顺序写，同时累计已写字节的 CRC32
+    class CheckpointWriter {
+    public:
+        explicit CheckpointWriter(int fd) : fd_(fd) {}
+
+        template <typename T>
+        void put(T value) { append(&value, sizeof(value)); }
+
+        void putBytes(std::string_view data) {
+            put(static_cast<uint32_t>(data.size()));
+            append(data.data(), data.size());
+        }
+
+        void append(const void *data, size_t len) {
+            buf_.append(static_cast<const char*>(data), len);
+            written_ += len;
+            crc_ = IndexWal::crc32(static_cast<const char*>(data), len, crc_);
+            if (buf_.size() >= (1 << 20)) flush();
+        }
+
+        bool flush() {
+            size_t done = 0;
+            while (ok_ && done < buf_.size()) {
+                ssize_t n = ::write(fd_, buf_.data() + done, buf_.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) ok_ = false;
+                else done += static_cast<size_t>(n);
+            }
+            buf_.clear();
+            return ok_;
+        }
+
+        uint64_t written() const { return written_; }
+        uint32_t crc() const { return crc_; }
+
+    private:
+        int fd_;
+        std::string buf_;
+        uint64_t written_ = 0;
+        uint32_t crc_ = 0;
+        bool ok_ = true;
+    };
+
+    // 在读入内存的文件内容上顺序读，越界后所有读取返回零值，最后检查 ok()
+    class CheckpointReader {
+    public:
+        CheckpointReader(const char *data, size_t size) : p_(data), end_(data + size) {}
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (static_cast<size_t>(end_ - p_) < sizeof(T)) {
+                ok_ = false;
+                return value;
+            }
+            std::memcpy(&value, p_, sizeof(T));
+            p_ += sizeof(T);
+            return value;
+        }
+
+        std::string_view getBytes(size_t len) {
+            if (static_cast<size_t>(end_ - p_) < len) {
+                ok_ = false;
+                return {};
+            }
+            std::string_view data(p_, len);
+            p_ += len;
+            return data;
+        }
+
+        std::string_view getBytes() { return getBytes(get<uint32_t>()); }
+
+        // 数组长度的合理性检查：剩余字节不足以容纳 n 个元素时视为损坏
+        bool fits(size_t n, size_t elem_bytes) {
+            if (n > static_cast<size_t>(end_ - p_) / elem_bytes) ok_ = false;
+            return ok_;
+        }
+
+        void fail() { ok_ = false; }
+        bool ok() const { return ok_; }
+
+    private:
+        const char *p_;
+        const char *end_;
+        bool ok_ = true;
+    };
+
+    void syncDir(const std::string &path) {
+        std::string dir = path.substr(0, path.find_last_of('/') + 1);
+        int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dfd >= 0) {
+            ::fsync(dfd);
+            ::close(dfd);
         }
     }
-    
-    return true;
+}
+
+long DynamicInvertedIndex::Segment::find(int docid) const {
+    auto it = std::lower_bound(docs.begin(), docs.end(), docid);
+    if (it == docs.end() || *it != docid) return -1;
+    return static_cast<long>(it - docs.begin());
+}
+
+DynamicInvertedIndex::DynamicInvertedIndex(const Options &opts)
+    : opts_(opts), store_(docStoreOptions(opts)) {
+    if (opts_.merge_factor < 2) opts_.merge_factor = 2;
+    if (opts_.partitions < 1) opts_.partitions = 1;
+    parts_.reserve(opts_.partitions);
+    for (size_t i = 0; i < opts_.partitions; ++i) {
+        parts_.push_back(std::make_unique<Partition>());
+        parts_.back()->view = std::make_shared<const View>();
+    }
+    // 调用线程也应用一个分区，线程池只需 分区数 - 1 个线程
+    if (opts_.partitions > 1) apply_pool_ = std::make_unique<ThreadPool>(opts_.partitions - 1);
+    merge_thread_ = std::thread(&DynamicInvertedIndex::mergeLoop, this);
+}
+
+DynamicInvertedIndex::~DynamicInvertedIndex() {
+    {
+        std::lock_guard<std::mutex> lock(merge_wait_mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    if (merge_thread_.joinable()) merge_thread_.join();
+}
+
+DynamicInvertedIndex::Snapshot DynamicInvertedIndex::loadSnapshot() const {
+    Snapshot snapshot;
+    snapshot.reserve(parts_.size());
+    for (const auto &part : parts_) snapshot.push_back(loadView(*part));
+    return snapshot;
+}
+
+std::vector<std::unique_lock<std::mutex>> DynamicInvertedIndex::lockAll() const {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(parts_.size());
+    for (const auto &part : parts_) locks.emplace_back(part->write_mutex);
+    return locks;
+}
+
+void DynamicInvertedIndex::attachBase(const WeightedInvertedIndex &base) {
+    // 只收集文档 ID，倒排列表与权重直接引用基础索引
+    std::vector<int> ids;
+    for (const auto &[term, list] : base.data()) {
+        for (const auto &entry : list) ids.push_back(entry.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::lock_guard<std::mutex> merge_lock(merge_mutex_);
+    auto locks = lockAll();
+    base_ = &base;
+    base_ids_ = std::move(ids);
+    // 与构建权重时的 N 一致，才能从权重中还原 TF
+    base_docs_ = std::max(base.docCount(), base_ids_.size());
+
+    for (auto &part : parts_) {
+        View next = *loadView(*part);
+        next.base_dead.reset();
+        publishLocked(*part, std::move(next));
+    }
 }
 
 void DynamicInvertedIndex::addDocument(int docid, const std::string &text) {
-    std::unique_lock lock(mutex_);
-    
-    // 如果文档已存在，先删除
-    if (doc_tokens_.count(docid)) {
-        deleted_docs_.insert(docid);
-    }
-    
-    // 分词
-    auto tokens = tokenize(text);
-    doc_tokens_[docid] = tokens;
-    deleted_docs_.erase(docid);
-    
-    // 计算TF-IDF并更新索引
-    computeTFIDF(docid, tokens);
-    
-    total_docs_++;
-    
-    // 重新计算IDF
-    recomputeIDF();
+    addTokenized(docid, tokenize(text), nullptr);
 }
 
 void DynamicInvertedIndex::addDocument(int docid, const DocumentMeta &meta) {
-    std::unique_lock lock(mutex_);
-    
-    // 如果文档已存在，先删除
-    if (doc_tokens_.count(docid)) {
-        deleted_docs_.insert(docid);
-    }
-    
-    // 存储元数据
-    doc_metadata_[docid] = meta;
-    
     // 分词（使用完整文本）
-    auto tokens = tokenize(meta.text);
-    doc_tokens_[docid] = tokens;
-    deleted_docs_.erase(docid);
-    
-    // 计算TF-IDF并更新索引
-    computeTFIDF(docid, tokens);
-    
-    total_docs_++;
-    
-    // 重新计算IDF
-    recomputeIDF();
+    addTokenized(docid, tokenize(meta.text), &meta);
+}
+
+void DynamicInvertedIndex::addTokenized(int docid, const std::vector<std::string> &tokens,
+                                        const DocumentMeta *meta) {
+    if (docid < 0) return;  // 内部 ID 为非负整数
+
+    Partition &part = partitionOf(docid);
+    std::vector<std::string> changed;
+    bool all;
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(part.write_mutex);
+        all = !collectOldTerms(part, docid, changed);
+        changed.insert(changed.end(), tokens.begin(), tokens.end());
+
+        // 写入新段（已存在的旧版本会先被标记删除）并发布
+        View next = *loadView(part);
+        TombstoneCopies copies;
+        addBatchLocked(part, {{docid, &tokens, meta}}, next, copies);
+        publishLocked(part, std::move(next));
+
+        // 在写锁内追加 WAL，日志顺序与应用顺序一致
+        lsn = logAddLocked(docid, tokens, meta);
+    }
+    waitDurable(lsn);
+    requestMerge();
+    notifyChange(std::move(changed), all);
 }
 
 bool DynamicInvertedIndex::getDocumentMeta(int docid, DocumentMeta &meta) const {
-    std::shared_lock lock(mutex_);
-    
-    auto it = doc_metadata_.find(docid);
-    if (it == doc_metadata_.end() || deleted_docs_.count(docid)) {
-        return false;
+    if (docid < 0) return false;
+    auto view = loadView(partitionOf(docid));
+
+    // 新段在后，存活版本通常在最近的段中
+    for (auto it = view->segments.rbegin(); it != view->segments.rend(); ++it) {
+        long ord = it->seg->find(docid);
+        if (ord < 0 || it->isDead(static_cast<uint32_t>(ord))) continue;
+        DocStore::Handle handle = it->seg->metas[ord];
+        return handle != 0 && loadMeta(handle, meta);
+    }
+    return false;
+}
+
+bool DynamicInvertedIndex::contains(int docid) const {
+    if (docid < 0) return false;
+    auto view = loadView(partitionOf(docid));
+    for (auto it = view->segments.rbegin(); it != view->segments.rend(); ++it) {
+        long ord = it->seg->find(docid);
+        if (ord >= 0 && !it->isDead(static_cast<uint32_t>(ord))) return true;
+    }
+    return baseLive(docid, *view);
+}
+
+void DynamicInvertedIndex::forEachDocTerms(
+    const std::function<void(int docid, const std::vector<std::string> &terms)> &fn) const {
+    const size_t n = parts_.size();
+    std::vector<std::string> terms;
+    for (size_t p = 0; p < n; ++p) {
+        const Partition &part = *parts_[p];
+        std::lock_guard<std::mutex> lock(part.write_mutex);
+        for (size_t slot = 0; slot < part.docs.size(); ++slot) {
+            const DocState &state = part.docs[slot];
+            if (!state.seg || state.tokens.empty()) continue;
+            terms.clear();
+            for (uint32_t id : state.tokens) terms.push_back(part.terms[id]);
+            fn(static_cast<int>(slot * n + p), terms);
+        }
     }
-    
-    meta = it->second;
-    return true;
 }
 
 void DynamicInvertedIndex::addDocuments(const std::vector<std::pair<int, std::string>> &documents) {
-    std::unique_lock lock(mutex_);
-    
-    for (const auto &[docid, text] : documents) {
-        auto tokens = tokenize(text);
-        doc_tokens_[docid] = tokens;
-        deleted_docs_.erase(docid);
-        computeTFIDF(docid, tokens);
+    // 分词在锁外完成
+    std::vector<Update> updates(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        updates[i].docid = documents[i].first;
+        updates[i].tokens = tokenize(documents[i].second);
     }
-    
-    total_docs_ += documents.size();
-    recomputeIDF();
+    applyBatch(updates);
+}
+
+bool DynamicInvertedIndex::applyBatch(const std::vector<Update> &updates) {
+    if (updates.empty()) return true;
+
+    // 按分区拆开，分区内保持原有顺序（同一文档总在同一分区）
+    const size_t n = parts_.size();
+    std::vector<std::vector<const Update*>> groups(n);
+    for (const auto &update : updates) {
+        if (update.docid < 0) continue;  // 内部 ID 为非负整数
+        groups[static_cast<size_t>(update.docid) % n].push_back(&update);
+    }
+    std::vector<size_t> active;
+    for (size_t i = 0; i < n; ++i) {
+        if (!groups[i].empty()) active.push_back(i);
+    }
+    if (active.empty()) return true;
+
+    struct PartResult {
+        std::vector<std::string> changed;
+        bool all = false;
+        uint64_t lsn = 0;
+    };
+    std::vector<PartResult> results(n);
+    auto run = [&](size_t i) {
+        results[i].lsn = applyPartition(*parts_[i], groups[i], results[i].changed, results[i].all);
+    };
+
+    // 各分区的写锁互不相关：其余分区交给线程池，调用线程应用第一个，再等全部完成
+    if (active.size() == 1 || !apply_pool_) {
+        for (size_t i : active) run(i);
+    } else {
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        size_t pending = active.size() - 1;
+        for (size_t k = 1; k < active.size(); ++k) {
+            apply_pool_->enqueue([&, i = active[k]]() {
+                run(i);
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (--pending == 0) done_cv.notify_one();
+            });
+        }
+        run(active[0]);
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&pending]() { return pending == 0; });
+    }
+
+    std::vector<std::string> changed;
+    bool all = false;
+    uint64_t lsn = 0;
+    for (size_t i : active) {
+        auto &result = results[i];
+        changed.insert(changed.end(), std::make_move_iterator(result.changed.begin()),
+                       std::make_move_iterator(result.changed.end()));
+        all |= result.all;
+        lsn = std::max(lsn, result.lsn);
+    }
+    // 整批共享一次落盘等待（组提交按 LSN 递增落盘，最大的 LSN 落盘即全部落盘）
+    bool durable = waitDurable(lsn);
+    requestMerge();
+    notifyChange(std::move(changed), all);
+    return durable;
+}
+
+uint64_t DynamicInvertedIndex::applyPartition(Partition &part, const std::vector<const Update*> &updates,
+                                              std::vector<std::string> &changed, bool &all) {
+    uint64_t lsn = 0;
+    std::lock_guard<std::mutex> lock(part.write_mutex);
+    View next = *loadView(part);
+    TombstoneCopies copies;
+
+    // 连续的写入攒成一个段；遇到删除时先写入之前攒下的文档，保持同一文档的先后顺序
+    std::vector<PendingDoc> run;
+    for (const Update *update : updates) {
+        if (!collectOldTerms(part, update->docid, changed)) all = true;
+        if (!update->remove) {
+            changed.insert(changed.end(), update->tokens.begin(), update->tokens.end());
+            run.push_back({update->docid, &update->tokens, update->meta.get()});
+            lsn = logAddLocked(update->docid, update->tokens, update->meta.get());
+            continue;
+        }
+        addBatchLocked(part, run, next, copies);
+        run.clear();
+        if (removeLocked(part, update->docid, next, copies)) {
+            lsn = logDeleteLocked(update->docid);
+        }
+    }
+    addBatchLocked(part, run, next, copies);
+    publishLocked(part, std::move(next));
+    return lsn;
 }
 
 void DynamicInvertedIndex::removeDocument(int docid) {
-    std::unique_lock lock(mutex_);
-    
-    deleted_docs_.insert(docid);
-    
-    // 自动压缩检查
-    if (needsCompaction()) {
-        compact();
+    if (docid < 0) return;
+    Partition &part = partitionOf(docid);
+    std::vector<std::string> changed;
+    bool all;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(part.write_mutex);
+        all = !collectOldTerms(part, docid, changed);
+
+        // 只打删除标记，清理交给后台合并，不阻塞读者
+        View next = *loadView(part);
+        TombstoneCopies copies;
+        if (removeLocked(part, docid, next, copies)) {
+            publishLocked(part, std::move(next));
+            lsn = logDeleteLocked(docid);
+        }
     }
+    waitDurable(lsn);
+    requestMerge();
+    notifyChange(std::move(changed), all);
 }
 
 void DynamicInvertedIndex::updateDocument(int docid, const std::string &new_text) {
-    removeDocument(docid);
+    // 写入会替换旧版本，无需先删除（也避免文档短暂不可见）
     addDocument(docid, new_text);
 }
 
-std::vector<std::pair<int, double>> DynamicInvertedIndex::searchANDCosineRanked(
-    const std::vector<std::string> &terms) const {
-    
-    std::shared_lock lock(mutex_);
-    
-    if (terms.empty()) return {};
-    
-    // 1. 找到包含所有查询词的文档（AND语义）
-    std::unordered_map<int, std::vector<double>> doc_weights;
-    
-    for (size_t i = 0; i < terms.size(); ++i) {
-        auto it = postings_.find(terms[i]);
-        if (it == postings_.end()) return {};  // 有词不存在，返回空
-        
-        for (const auto &[docid, weight] : it->second) {
-            // 跳过已删除的文档
-            if (deleted_docs_.count(docid)) continue;
-            
-            if (doc_weights[docid].empty()) {
-                doc_weights[docid].resize(terms.size(), 0.0);
+std::shared_ptr<DynamicInvertedIndex::Segment> DynamicInvertedIndex::buildSegment(
+    const std::vector<PendingDoc> &docs, const std::vector<DocStore::Handle> &handles) {
+    // 同一 docid 取批内最后一次
+    std::unordered_map<int, size_t> last;
+    for (size_t i = 0; i < docs.size(); ++i) last[docs[i].docid] = i;
+
+    auto seg = std::make_shared<Segment>();
+    seg->docs.reserve(last.size());
+    for (const auto &entry : last) seg->docs.push_back(entry.first);
+    std::sort(seg->docs.begin(), seg->docs.end());
+    seg->metas.resize(seg->docs.size());
+
+    // 按序号递增写入，倒排列表天然有序；只保存归一化 TF（与基础索引同一公式）
+    for (uint32_t ord = 0; ord < seg->docs.size(); ++ord) {
+        size_t index = last[seg->docs[ord]];
+        const auto &tokens = *docs[index].tokens;
+
+        // 计算词频
+        std::unordered_map<std::string, int> tf_map;
+        int max_tf = 0;
+        for (const auto &token : tokens) {
+            max_tf = std::max(max_tf, ++tf_map[token]);
+        }
+        for (const auto &[term, tf] : tf_map) {
+            seg->postings[term].push_back({ord, 0.5 + 0.5 * tf / max_tf});
+        }
+        seg->metas[ord] = handles[index];
+    }
+    return seg;
+}
+
+void DynamicInvertedIndex::addBatchLocked(Partition &part, const std::vector<PendingDoc> &docs, View &next,
+                                          TombstoneCopies &copies) {
+    if (docs.empty()) return;
+
+    // 新元数据写入文档存储，被替换的旧记录标记失效；未提供元数据时沿用旧版本的记录
+    std::vector<DocStore::Handle> handles(docs.size());
+    std::unordered_map<int, DocStore::Handle> batch_meta;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        const auto &doc = docs[i];
+        DocStore::Handle prev = 0;
+        auto seen = batch_meta.find(doc.docid);
+        if (seen != batch_meta.end()) {
+            prev = seen->second;
+        } else if (const DocState *state = findDocLocked(part, doc.docid)) {
+            prev = state->seg->metas[state->ord];
+        }
+        handles[i] = prev;
+        if (doc.meta) {
+            handles[i] = storeMeta(*doc.meta);
+            if (prev) store_.release(prev);
+        }
+        batch_meta[doc.docid] = handles[i];
+    }
+
+    // 旧版本在所在段标记删除
+    for (const auto &entry : batch_meta) {
+        deleteLocked(part, entry.first, next, copies);
+    }
+
+    auto seg = buildSegment(docs, handles);
+    seg->id = next_segment_id_++;
+    for (uint32_t ord = 0; ord < seg->docs.size(); ++ord) {
+        DocState &state = docStateLocked(part, seg->docs[ord]);
+        state.seg = seg.get();
+        state.ord = ord;
+    }
+    for (const auto &doc : docs) {
+        setDocTokensLocked(part, doc.docid, *doc.tokens);
+    }
+    next.stored_docs += seg->docs.size();
+    next.segments.push_back({std::move(seg), nullptr});
+}
+
+bool DynamicInvertedIndex::deleteLocked(Partition &part, int docid, View &next, TombstoneCopies &copies) {
+    DocState *state = findDocLocked(part, docid);
+    if (!state) return maskBaseLocked(docid, next, copies);
+    const Segment *seg = state->seg;
+    uint32_t ord = state->ord;
+    state->seg = nullptr;
+
+    for (auto &ref : next.segments) {
+        if (ref.seg.get() != seg) continue;
+        // 写时复制：已发布的位图对读者不可变
+        auto &copy = copies[seg];
+        if (!copy) {
+            copy = ref.dead ? std::make_shared<Tombstones>(*ref.dead) : std::make_shared<Tombstones>();
+            copy->bits.resize((seg->docs.size() + 63) / 64, 0);
+            ref.dead = copy;
+        }
+        uint64_t mask = 1ULL << (ord & 63);
+        if (!(copy->bits[ord >> 6] & mask)) {
+            copy->bits[ord >> 6] |= mask;
+            copy->count++;
+        }
+        break;
+    }
+    return true;
+}
+
+bool DynamicInvertedIndex::maskBaseLocked(int docid, View &next, TombstoneCopies &copies) {
+    long ord = baseOrd(docid);
+    if (ord < 0) return false;
+
+    auto &copy = copies[nullptr];
+    if (!copy) {
+        copy = next.base_dead ? std::make_shared<Tombstones>(*next.base_dead) : std::make_shared<Tombstones>();
+        copy->bits.resize((base_ids_.size() + 63) / 64, 0);
+        next.base_dead = copy;
+    }
+    uint64_t mask = 1ULL << (ord & 63);
+    if (copy->bits[ord >> 6] & mask) return false;
+    copy->bits[ord >> 6] |= mask;
+    copy->count++;
+    return true;
+}
+
+long DynamicInvertedIndex::baseOrd(int docid) const {
+    auto it = std::lower_bound(base_ids_.begin(), base_ids_.end(), docid);
+    if (it == base_ids_.end() || *it != docid) return -1;
+    return static_cast<long>(it - base_ids_.begin());
+}
+
+bool DynamicInvertedIndex::baseLive(int docid, const View &view) const {
+    long ord = baseOrd(docid);
+    return ord >= 0 && !(view.base_dead && view.base_dead->test(static_cast<uint32_t>(ord)));
+}
+
+bool DynamicInvertedIndex::removeLocked(Partition &part, int docid, View &next, TombstoneCopies &copies) {
+    const DocState *state = findDocLocked(part, docid);
+    // 基础文档没有元数据与分词结果，只需屏蔽
+    if (!state) return maskBaseLocked(docid, next, copies);
+    DocStore::Handle handle = state->seg->metas[state->ord];
+
+    deleteLocked(part, docid, next, copies);
+    if (handle) store_.release(handle);
+    eraseDocTokensLocked(part, docid);
+    return true;
+}
+
+DocStore::Handle DynamicInvertedIndex::storeMeta(const DocumentMeta &meta) {
+    std::string record;
+    putStr(record, meta.title);
+    putStr(record, meta.link);
+    putStr(record, meta.summary);
+    putStr(record, opts_.store_text ? meta.text : std::string());
+
+    // 对比口径：原先每个文档一个 shared_ptr<DocumentMeta>（含控制块）与四个字符串
+    size_t legacy = sizeof(DocumentMeta) + 16 + stringBytes(meta.title) + stringBytes(meta.link) +
+                    stringBytes(meta.summary) + stringBytes(meta.text) - 4 * sizeof(std::string);
+    return store_.append(record, legacy);
+}
+
+bool DynamicInvertedIndex::loadMeta(DocStore::Handle handle, DocumentMeta &meta) const {
+    std::string record;
+    if (!store_.read(handle, record)) return false;
+    std::string_view in(record);
+    return getStr(in, meta.title) && getStr(in, meta.link) &&
+           getStr(in, meta.summary) && getStr(in, meta.text);
+}
+
+uint32_t DynamicInvertedIndex::internTermLocked(Partition &part, const std::string &term) {
+    auto [it, inserted] = part.term_ids.emplace(term, static_cast<uint32_t>(part.terms.size()));
+    if (inserted) {
+        part.terms.push_back(term);
+        dict_bytes_ += 2 * stringBytes(term) + sizeof(uint32_t) + 32;  // 两份字符串 + 哈希节点
+        dict_terms_++;  // 各分区词典之和
+    }
+    return it->second;
+}
+
+void DynamicInvertedIndex::setDocTokensLocked(Partition &part, int docid, const std::vector<std::string> &tokens) {
+    eraseDocTokensLocked(part, docid);
+    if (tokens.empty()) return;  // 空序列不占堆内存，也不计入统计
+
+    std::vector<uint32_t> ids;
+    ids.reserve(tokens.size());
+    uint64_t legacy = sizeof(std::vector<std::string>);
+    for (const auto &token : tokens) {
+        ids.push_back(internTermLocked(part, token));
+        legacy += stringBytes(token);
+    }
+    ids.shrink_to_fit();
+    token_bytes_ += sizeof(ids) + ids.capacity() * sizeof(uint32_t);
+    token_legacy_bytes_ += legacy;
+    docStateLocked(part, docid).tokens = std::move(ids);
+}
+
+void DynamicInvertedIndex::eraseDocTokensLocked(Partition &part, int docid) {
+    DocState *state = findDocLocked(part, docid);
+    if (!state) return;
+    auto &ids = state->tokens;
+    if (ids.capacity() == 0) return;
+    uint64_t legacy = sizeof(std::vector<std::string>);
+    for (uint32_t id : ids) legacy += stringBytes(part.terms[id]);
+    token_bytes_ -= sizeof(ids) + ids.capacity() * sizeof(uint32_t);
+    token_legacy_bytes_ -= legacy;
+    std::vector<uint32_t>().swap(ids);
+}
+
+DynamicInvertedIndex::DocState *DynamicInvertedIndex::findDocLocked(Partition &part, int docid) const {
+    if (docid < 0) return nullptr;
+    size_t slot = static_cast<size_t>(docid) / parts_.size();
+    if (slot >= part.docs.size()) return nullptr;
+    DocState &state = part.docs[slot];
+    return state.seg ? &state : nullptr;
+}
+
+DynamicInvertedIndex::DocState &DynamicInvertedIndex::docStateLocked(Partition &part, int docid) const {
+    size_t slot = static_cast<size_t>(docid) / parts_.size();
+    if (slot >= part.docs.size()) part.docs.resize(slot + 1);
+    return part.docs[slot];
+}
+
+void DynamicInvertedIndex::publishLocked(Partition &part, View next) {
+    std::atomic_store(&part.view, ViewPtr(std::make_shared<const View>(std::move(next))));
+}
+
+std::vector<DynamicInvertedIndex::SegmentRef> DynamicInvertedIndex::pickMerge(const View &view) const {
+    // 1. 删除比例过高的段单独重写
+    for (const auto &ref : view.segments) {
+        if (ref.deadCount() > 0 &&
+            ref.deadCount() > ref.seg->docs.size() * opts_.expunge_ratio) {
+            return {ref};
+        }
+    }
+
+    // 2. 分层合并：按存活文档数的 log(merge_factor) 分层，同层段数达到 merge_factor 时合并
+    std::unordered_map<int, std::vector<SegmentRef>> tiers;
+    const double base = std::log(static_cast<double>(opts_.merge_factor));
+    for (const auto &ref : view.segments) {
+        size_t live = std::max<size_t>(ref.liveDocs(), 1);
+        int tier = static_cast<int>(std::log(static_cast<double>(live)) / base);
+        tiers[tier].push_back(ref);
+    }
+    int best = -1;
+    for (const auto &[tier, refs] : tiers) {
+        if (refs.size() >= opts_.merge_factor && (best < 0 || tier < best)) best = tier;
+    }
+    if (best < 0) return {};
+
+    auto picked = tiers[best];
+    std::sort(picked.begin(), picked.end(), [](const SegmentRef &a, const SegmentRef &b) {
+        return a.liveDocs() < b.liveDocs();
+    });
+    picked.resize(opts_.merge_factor);
+    return picked;
+}
+
+bool DynamicInvertedIndex::throttleMerge(std::chrono::steady_clock::time_point &chunk_start,
+                                         size_t work) {
+    using namespace std::chrono;
+    auto busy = steady_clock::now() - chunk_start;
+    steady_clock::duration pause{0};
+
+    // 速率上限：本批工作量至少要花 work / rate 秒
+    if (opts_.merge_rate_limit > 0) {
+        auto min_time = duration_cast<steady_clock::duration>(
+            duration<double>(static_cast<double>(work) / opts_.merge_rate_limit));
+        if (busy < min_time) pause = min_time - busy;
+    }
+    // CPU 占比：每工作 busy 时长，休眠 busy * (100 - p) / p
+    if (opts_.merge_cpu_percent > 0 && opts_.merge_cpu_percent < 100) {
+        pause = std::max(pause, busy * (100 - opts_.merge_cpu_percent) / opts_.merge_cpu_percent);
+    }
+
+    if (pause > steady_clock::duration::zero()) {
+        std::unique_lock<std::mutex> lock(merge_wait_mutex_);
+        merge_cv_.wait_for(lock, pause, [this]() { return stopping_.load(); });
+    }
+    chunk_start = steady_clock::now();
+    return !stopping_;
+}
+
+bool DynamicInvertedIndex::mergeSegments(Partition &part, const std::vector<SegmentRef> &sources) {
+    // 调用方持有 merge_mutex_；源段与其删除位图均不可变，构建全程不加锁
+    size_t total = 0;
+    for (const auto &src : sources) {
+        for (const auto &[term, list] : src.seg->postings) total += list.size();
+    }
+
+    // 进度：按已处理的倒排项计
+    merge_total_ = total;
+    merge_done_ = 0;
+    merge_running_ = true;
+    struct RunningGuard {
+        std::atomic<bool> &flag;
+        ~RunningGuard() { flag = false; }
+    } running_guard{merge_running_};
+
+    // 1. 存活文档按 docid 排序，得到新序号
+    struct Origin {
+        int docid;
+        size_t src;
+        uint32_t ord;
+    };
+    std::vector<Origin> live;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const auto &seg = *sources[i].seg;
+        for (uint32_t ord = 0; ord < seg.docs.size(); ++ord) {
+            if (!sources[i].isDead(ord)) live.push_back({seg.docs[ord], i, ord});
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const Origin &a, const Origin &b) { return a.docid < b.docid; });
+
+    auto merged = std::make_shared<Segment>();
+    std::vector<std::vector<int64_t>> remap(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) remap[i].assign(sources[i].seg->docs.size(), -1);
+    merged->docs.reserve(live.size());
+    merged->metas.reserve(live.size());
+    for (const auto &o : live) {
+        remap[o.src][o.ord] = static_cast<int64_t>(merged->docs.size());
+        merged->docs.push_back(o.docid);
+        merged->metas.push_back(sources[o.src].seg->metas[o.ord]);
+    }
+
+    // 2. 重写倒排列表：分批处理并按预算让出 CPU；停止时放弃本次合并
+    constexpr size_t kChunk = 4096;
+    size_t chunk = 0;
+    auto chunk_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (const auto &[term, list] : sources[i].seg->postings) {
+            auto &out = merged->postings[term];
+            for (const auto &[ord, tf] : list) {
+                int64_t new_ord = remap[i][ord];
+                if (new_ord >= 0) out.push_back({static_cast<uint32_t>(new_ord), tf});
+            }
+            chunk += list.size();
+            if (chunk >= kChunk) {
+                merge_done_ += chunk;
+                if (!throttleMerge(chunk_start, chunk)) return false;
+                chunk = 0;
             }
-            doc_weights[docid][i] = weight;
         }
     }
-    
-    // 2. 过滤：只保留包含所有查询词的文档
-    std::vector<int> valid_docs;
-    for (const auto &[docid, weights] : doc_weights) {
-        bool has_all = true;
-        for (double w : weights) {
-            if (w == 0.0) {
-                has_all = false;
-                break;
+    for (auto it = merged->postings.begin(); it != merged->postings.end(); ) {
+        if (it->second.empty()) {
+            it = merged->postings.erase(it);
+        } else {
+            if (sources.size() > 1) std::sort(it->second.begin(), it->second.end());
+            ++it;
+        }
+    }
+    merge_done_ = total;
+
+    // 3. 发布：补上合并期间发生的删除，把文档归属切到新段，以新版本替换源段
+    std::lock_guard<std::mutex> lock(part.write_mutex);
+    merged->id = next_segment_id_++;
+    View next = *loadView(part);
+
+    std::unordered_set<const Segment*> replaced;
+    for (const auto &src : sources) replaced.insert(src.seg.get());
+
+    auto dead = std::make_shared<Tombstones>();
+    for (const auto &ref : next.segments) {
+        if (!replaced.count(ref.seg.get()) || ref.deadCount() == 0) continue;
+        size_t i = 0;
+        while (sources[i].seg != ref.seg) ++i;
+        if (ref.deadCount() == sources[i].deadCount()) continue;
+        for (uint32_t ord = 0; ord < ref.seg->docs.size(); ++ord) {
+            if (!ref.isDead(ord) || sources[i].isDead(ord) || remap[i][ord] < 0) continue;
+            uint32_t new_ord = static_cast<uint32_t>(remap[i][ord]);
+            if (dead->bits.empty()) dead->bits.resize((merged->docs.size() + 63) / 64, 0);
+            dead->bits[new_ord >> 6] |= 1ULL << (new_ord & 63);
+            dead->count++;
+        }
+    }
+
+    for (uint32_t ord = 0; ord < merged->docs.size(); ++ord) {
+        DocState *state = findDocLocked(part, merged->docs[ord]);
+        if (state && replaced.count(state->seg)) {
+            state->seg = merged.get();
+            state->ord = ord;
+        }
+    }
+
+    next.segments.erase(std::remove_if(next.segments.begin(), next.segments.end(),
+                                       [&replaced](const SegmentRef &r) { return replaced.count(r.seg.get()) > 0; }),
+                        next.segments.end());
+    if (!merged->docs.empty()) {
+        std::shared_ptr<const Tombstones> merged_dead;
+        if (dead->count > 0) merged_dead = std::move(dead);
+        next.segments.push_back({std::move(merged), std::move(merged_dead)});
+    }
+    next.stored_docs = 0;
+    for (const auto &ref : next.segments) next.stored_docs += ref.seg->docs.size();
+    publishLocked(part, std::move(next));
+    merges_++;
+    return true;
+}
+
+void DynamicInvertedIndex::requestMerge() {
+    {
+        std::lock_guard<std::mutex> lock(merge_wait_mutex_);
+        merge_requested_ = true;
+    }
+    merge_cv_.notify_one();
+}
+
+void DynamicInvertedIndex::mergeLoop() {
+    const auto interval = std::chrono::seconds(1);
+    while (true) {
+        bool run_compact;
+        {
+            std::unique_lock<std::mutex> lock(merge_wait_mutex_);
+            merge_cv_.wait_for(lock, interval, [this]() {
+                return stopping_ || merge_requested_ || compact_requested_;
+            });
+            if (stopping_) break;
+            merge_requested_ = false;
+            run_compact = compact_requested_;
+            compact_requested_ = false;
+        }
+
+        // 手动触发的全量压缩
+        if (run_compact) compact();
+
+        // 日志自上次检查点以来增长超过阈值时重写
+        if (opts_.wal_checkpoint_bytes > 0) {
+            IndexWal *wal = wal_;
+            bool due = wal && wal->sizeBytes() > wal_checkpoint_base_ + opts_.wal_checkpoint_bytes;
+            if (due && !checkpoint()) {
+                std::cerr << "⚠ WAL checkpoint failed" << std::endl;
             }
         }
-        if (has_all) {
-            valid_docs.push_back(docid);
+
+        // 逐个分区合并直到没有满足策略的段（段不跨分区）
+        for (auto &part : parts_) {
+            while (!stopping_) {
+                std::lock_guard<std::mutex> merge_lock(merge_mutex_);
+                auto picked = pickMerge(*loadView(*part));
+                if (picked.empty() || !mergeSegments(*part, picked)) break;
+            }
         }
     }
-    
-    // 3. 计算查询向量的权重
+}
+
+std::vector<std::pair<int, double>> DynamicInvertedIndex::searchANDCosineRanked(
+    const std::vector<std::string> &raw_terms, size_t top_k) const {
+
+    if (raw_terms.empty()) return {};
+
+    // 取得各分区的版本后全程只读，不与写者共享任何锁
+    auto snapshot = loadSnapshot();
+    using PostingList = std::vector<std::pair<uint32_t, double>>;
+    using BaseList = std::set<std::pair<int, double>>;
+
+    // 查询词去重，重复次数作为查询 TF
+    std::vector<std::string> terms;
+    std::vector<int> query_tf;
+    for (const auto &term : raw_terms) {
+        auto it = std::find(terms.begin(), terms.end(), term);
+        if (it == terms.end()) {
+            terms.push_back(term);
+            query_tf.push_back(1);
+        } else {
+            query_tf[it - terms.begin()]++;
+        }
+    }
+    const int max_query_tf = *std::max_element(query_tf.begin(), query_tf.end());
+
+    // 所有分区的段一起求交并进入同一个 top-k 堆，等价于各分区取 top-k 后再归并
+    std::vector<const SegmentRef*> segs;
+    size_t stored_docs = 0;
+    for (const auto &view : snapshot) {
+        for (const auto &ref : view->segments) segs.push_back(&ref);
+        stored_docs += view->stored_docs;
+    }
+
+    // 1. 基础索引与各段的倒排列表，DF 为列表长度之和（跨分区的全局 DF）
+    const size_t num_segs = segs.size();
+    std::vector<const BaseList*> base_lists(terms.size(), nullptr);
+    std::vector<const PostingList*> lists(num_segs * terms.size(), nullptr);
+    std::vector<size_t> df(terms.size(), 0);
+    for (size_t i = 0; i < terms.size() && base_; ++i) {
+        auto it = base_->data().find(terms[i]);
+        if (it == base_->data().end()) continue;
+        base_lists[i] = &it->second;
+        df[i] += it->second.size();
+    }
+    for (size_t s = 0; s < num_segs; ++s) {
+        const auto &postings = segs[s]->seg->postings;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            auto it = postings.find(terms[i]);
+            if (it == postings.end()) continue;
+            lists[s * terms.size() + i] = &it->second;
+            df[i] += it->second.size();
+        }
+    }
+
+    // 2. 按合并后的 DF/N 计算 IDF；查询向量的权重为 TF * IDF
+    const size_t total = base_docs_ + stored_docs;
+    std::vector<double> idf(terms.size());
     std::vector<double> query_weights(terms.size());
+    double query_norm = 0.0;
     for (size_t i = 0; i < terms.size(); ++i) {
-        double tf = 1.0;  // 查询词TF=1
-        size_t df = postings_.count(terms[i]) ? postings_.at(terms[i]).size() : 1;
-        double idf = std::log((double)total_docs_ / df);
-        query_weights[i] = tf * idf;
+        if (df[i] == 0) return {};  // 有词不存在，返回空
+        idf[i] = smoothIdf(total, df[i]);
+        query_weights[i] = (0.5 + 0.5 * query_tf[i] / max_query_tf) * idf[i];
+        query_norm += query_weights[i] * query_weights[i];
     }
-    
-    // 4. 计算余弦相似度
+    query_norm = std::sqrt(query_norm);
+
+    // 结果收集：top_k > 0 时用大小为 top_k 的堆，堆顶为当前最差的结果
+    auto better = [](const std::pair<int, double> &a, const std::pair<int, double> &b) {
+        if (a.second != b.second) return a.second > b.second;
+        return a.first < b.first;
+    };
     std::vector<std::pair<int, double>> results;
-    for (int docid : valid_docs) {
-        const auto &doc_vec = doc_weights[docid];
-        
-        double dot_product = 0.0, doc_norm = 0.0, query_norm = 0.0;
+    std::vector<double> doc_vec(terms.size());
+    auto offer = [&](int docid) {
+        double dot_product = 0.0, doc_norm = 0.0;
         for (size_t i = 0; i < terms.size(); ++i) {
             dot_product += query_weights[i] * doc_vec[i];
             doc_norm += doc_vec[i] * doc_vec[i];
-            query_norm += query_weights[i] * query_weights[i];
         }
-        
-        double cosine = dot_product / (std::sqrt(doc_norm) * std::sqrt(query_norm));
-        results.push_back({docid, cosine});
+        if (doc_norm == 0.0) return;
+        std::pair<int, double> hit{docid, dot_product / (std::sqrt(doc_norm) * query_norm)};
+        if (top_k == 0 || results.size() < top_k) {
+            results.push_back(hit);
+            if (top_k) std::push_heap(results.begin(), results.end(), better);
+        } else if (better(hit, results.front())) {
+            std::pop_heap(results.begin(), results.end(), better);
+            results.back() = hit;
+            std::push_heap(results.begin(), results.end(), better);
+        }
+    };
+
+    std::vector<size_t> order(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) order[i] = i;
+
+    // 3. 基础索引：权重按构建时的 IDF 还原为 TF，跳过被屏蔽的文档
+    bool base_has_all = base_ != nullptr;
+    for (size_t i = 0; i < terms.size(); ++i) base_has_all &= base_lists[i] != nullptr;
+    if (base_has_all) {
+        std::vector<double> base_idf(terms.size());
+        for (size_t i = 0; i < terms.size(); ++i) base_idf[i] = smoothIdf(base_docs_, base_lists[i]->size());
+        std::sort(order.begin(), order.end(), [&base_lists](size_t a, size_t b) {
+            return base_lists[a]->size() < base_lists[b]->size();
+        });
+
+        for (const auto &[docid, weight] : *base_lists[order[0]]) {
+            const View &owner = *snapshot[static_cast<size_t>(docid) % snapshot.size()];
+            if (owner.base_dead && owner.base_dead->test(static_cast<uint32_t>(baseOrd(docid)))) continue;
+            doc_vec[order[0]] = weight / base_idf[order[0]] * idf[order[0]];
+
+            bool matched = true;
+            for (size_t k = 1; k < terms.size() && matched; ++k) {
+                size_t i = order[k];
+                auto it = base_lists[i]->lower_bound({docid, -HUGE_VAL});
+                matched = it != base_lists[i]->end() && it->first == docid;
+                if (matched) doc_vec[i] = it->second / base_idf[i] * idf[i];
+            }
+            if (matched) offer(docid);
+        }
     }
-    
+
+    // 4. 逐段求 AND（列表按序号有序，以最短列表驱动）
+    std::vector<size_t> cursor(terms.size());
+    for (size_t s = 0; s < num_segs; ++s) {
+        const SegmentRef &ref = *segs[s];
+        const PostingList **seg_lists = &lists[s * terms.size()];
+        bool has_all = true;
+        for (size_t i = 0; i < terms.size(); ++i) has_all &= seg_lists[i] != nullptr;
+        if (!has_all) continue;  // 本段不含全部查询词
+
+        std::sort(order.begin(), order.end(), [seg_lists](size_t a, size_t b) {
+            return seg_lists[a]->size() < seg_lists[b]->size();
+        });
+        std::fill(cursor.begin(), cursor.end(), 0);
+
+        for (const auto &[ord, tf] : *seg_lists[order[0]]) {
+            // 跳过已删除的文档
+            if (ref.isDead(ord)) continue;
+            doc_vec[order[0]] = tf * idf[order[0]];
+
+            bool matched = true;
+            for (size_t k = 1; k < terms.size() && matched; ++k) {
+                size_t i = order[k];
+                const PostingList &list = *seg_lists[i];
+                auto it = std::lower_bound(list.begin() + cursor[i], list.end(), ord,
+                                           [](const auto &p, uint32_t o) { return p.first < o; });
+                cursor[i] = static_cast<size_t>(it - list.begin());
+                matched = it != list.end() && it->first == ord;
+                if (matched) doc_vec[i] = it->second * idf[i];  // TF * IDF
+            }
+            if (matched) offer(ref.seg->docs[ord]);
+        }
+    }
+
     // 5. 按相似度降序排序
-    std::sort(results.begin(), results.end(),
-              [](const auto &a, const auto &b) { return a.second > b.second; });
-    
+    std::sort(results.begin(), results.end(), better);
     return results;
 }
 
 DynamicInvertedIndex::Stats DynamicInvertedIndex::getStats() const {
-    std::shared_lock lock(mutex_);
-    
+    auto snapshot = loadSnapshot();
+
+    size_t deleted = 0, active = 0, pending = 0, stored = 0, segments = 0;
+    std::unordered_set<std::string_view> terms;
+    if (base_) {
+        active += base_ids_.size();
+        for (const auto &entry : base_->data()) terms.insert(entry.first);
+    }
+    for (const auto &view : snapshot) {
+        size_t masked = view->base_dead ? view->base_dead->count : 0;
+        deleted += masked;
+        active -= masked;
+        stored += view->stored_docs;
+        segments += view->segments.size();
+        for (const auto &ref : view->segments) {
+            deleted += ref.deadCount();
+            active += ref.liveDocs();
+            if (ref.seg->docs.size() < opts_.merge_factor) pending += ref.liveDocs();
+            for (const auto &entry : ref.seg->postings) terms.insert(entry.first);
+        }
+    }
+
+    // 节省的内存：原有结构的估算占用 - 文档存储 - 词 ID 序列 - 词典
+    auto store = store_.getStats();
+    uint64_t token_bytes = token_bytes_.load();
+    uint64_t legacy = store.logical_bytes + token_legacy_bytes_.load();
+    uint64_t current = store.arena_bytes + token_bytes + dict_bytes_.load();
+
     return {
-        total_docs_,
-        total_docs_ - deleted_docs_.size(),
-        deleted_docs_.size(),
-        postings_.size(),
-        0  // pending_updates
+        base_ids_.size() + stored,
+        active,
+        deleted,
+        terms.size(),
+        pending,
+        segments,
+        parts_.size(),
+        merges_.load(),
+        merge_running_.load(),
+        merge_done_.load(),
+        merge_total_.load(),
+        store.records,
+        store.arena_bytes,
+        store.dead_bytes,
+        token_bytes,
+        dict_terms_.load(),
+        legacy > current ? legacy - current : 0,
+        checkpoint_bytes_.load(),
+        checkpoint_ms_.load()
     };
 }
 
 bool DynamicInvertedIndex::needsCompaction() const {
-    std::shared_lock lock(mutex_);
-    return deleted_docs_.size() > total_docs_ * 0.2;  // 删除超过20%
+    size_t deleted = 0, stored = 0;
+    for (const auto &view : loadSnapshot()) {
+        for (const auto &ref : view->segments) deleted += ref.deadCount();
+        stored += view->stored_docs;
+    }
+    return deleted > stored * 0.2;  // 删除超过20%
 }
 
 bool DynamicInvertedIndex::saveToFile(const std::string &index_path) const {
-    std::shared_lock lock(mutex_);
-    
+    auto snapshot = loadSnapshot();
+
     std::ofstream ofs(index_path);
     if (!ofs) return false;
-    
-    for (const auto &[term, postings] : postings_) {
-        ofs << term;
-        for (const auto &[docid, weight] : postings) {
-            if (deleted_docs_.count(docid)) continue;  // 跳过已删除
-            ofs << " " << docid << " " << weight;
+
+    // 基础索引与各段同一词的倒排列表合并输出（TF），跳过已删除与被屏蔽的文档
+    struct TermPostings {
+        size_t df = 0;
+        std::vector<std::pair<int, double>> live;
+    };
+    std::unordered_map<std::string_view, TermPostings> merged;
+    if (base_) {
+        for (const auto &[term, list] : base_->data()) {
+            auto &out = merged[term];
+            out.df += list.size();
+            double base_idf = smoothIdf(base_docs_, list.size());
+            for (const auto &[docid, weight] : list) {
+                const View &owner = *snapshot[static_cast<size_t>(docid) % snapshot.size()];
+                if (baseLive(docid, owner)) out.live.push_back({docid, weight / base_idf});
+            }
+        }
+    }
+    size_t stored_docs = 0;
+    for (const auto &view : snapshot) {
+        stored_docs += view->stored_docs;
+        for (const auto &ref : view->segments) {
+            for (const auto &[term, list] : ref.seg->postings) {
+                auto &out = merged[term];
+                out.df += list.size();
+                for (const auto &[ord, tf] : list) {
+                    if (!ref.isDead(ord)) out.live.push_back({ref.seg->docs[ord], tf});
+                }
+            }
+        }
+    }
+
+    // 与 WeightedInvertedIndex::loadFromFile 相同的格式（term\tdocid:weight,...），
+    // 权重为按保存时刻 DF/N 计算的 TF-IDF，可直接作为下次启动的基础索引
+    const size_t total = base_docs_ + stored_docs;
+    for (auto &[term, postings] : merged) {
+        if (postings.live.empty()) continue;
+        std::sort(postings.live.begin(), postings.live.end());
+        double idf = smoothIdf(total, postings.df);
+        ofs << term << '\t';
+        for (size_t i = 0; i < postings.live.size(); ++i) {
+            if (i > 0) ofs << ',';
+            ofs << postings.live[i].first << ':' << postings.live[i].second * idf;
         }
         ofs << "\n";
     }
-    
-    return true;
+
+    return static_cast<bool>(ofs);
 }
 
 void DynamicInvertedIndex::compact() {
-    // 已在锁内调用，不需要再加锁
-    
-    // 从索引中移除已删除的文档
-    for (auto &[term, postings] : postings_) {
-        for (auto it = postings.begin(); it != postings.end(); ) {
-            if (deleted_docs_.count(it->first)) {
-                it = postings.erase(it);
-            } else {
-                ++it;
-            }
+    std::lock_guard<std::mutex> merge_lock(merge_mutex_);
+    for (auto &part : parts_) {
+        auto view = loadView(*part);
+
+        bool has_deleted = false;
+        for (const auto &ref : view->segments) has_deleted |= ref.deadCount() > 0;
+
+        // 每个分区全部合并为一个段，删除的文档在构建时丢弃；构建期间读者不受影响
+        if (view->segments.size() > 1 || has_deleted) {
+            if (!mergeSegments(*part, view->segments)) break;
         }
     }
-    
-    // 清空删除列表
-    total_docs_ -= deleted_docs_.size();
-    deleted_docs_.clear();
-    
-    // 重新计算IDF
-    recomputeIDF();
 }
 
-std::vector<std::string> DynamicInvertedIndex::tokenize(const std::string &text) const {
-    // 使用JiebaTokenizer分词
-    std::vector<std::string> tokens;
-    JiebaTokenizer::instance().tokenize(text, tokens);
-    return tokens;
+void DynamicInvertedIndex::requestCompaction() {
+    {
+        std::lock_guard<std::mutex> lock(merge_wait_mutex_);
+        compact_requested_ = true;
+    }
+    merge_cv_.notify_all();
 }
 
-void DynamicInvertedIndex::computeTFIDF(int docid, const std::vector<std::string> &tokens) {
-    // 计算词频
-    std::unordered_map<std::string, int> tf_map;
-    for (const auto &token : tokens) {
-        tf_map[token]++;
-    }
-    
-    // 计算TF-IDF并更新倒排表
-    for (const auto &[term, tf] : tf_map) {
-        double tf_value = (double)tf / tokens.size();
-        
-        // DF会在recomputeIDF中统一计算
-        postings_[term].insert({docid, tf_value});
-    }
-}
-
-void DynamicInvertedIndex::recomputeIDF() {
-    // 重新计算所有词的IDF并更新权重
-    for (auto &[term, postings] : postings_) {
-        size_t df = postings.size();
-        double idf = std::log((double)total_docs_ / df);
-        
-        // 更新所有文档的TF-IDF权重
-        std::set<std::pair<int, double>> new_postings;
-        for (const auto &[docid, tf] : postings) {
-            if (!deleted_docs_.count(docid)) {
-                new_postings.insert({docid, tf * idf});
+uint64_t DynamicInvertedIndex::logAddLocked(int docid, const std::vector<std::string> &tokens,
+                                            const DocumentMeta *meta) {
+    IndexWal *wal = wal_;
+    if (!wal) return 0;
+    IndexWal::Record record;
+    record.type = IndexWal::OpType::Add;
+    record.docid = docid;
+    if (meta) {
+        record.has_meta = true;
+        record.title = meta->title;
+        record.link = meta->link;
+        record.summary = meta->summary;
+        if (opts_.store_text) record.text = meta->text;  // 不保留全文时日志也不写
+    }
+    record.tokens = tokens;
+    return wal->append(record);
+}
+
+uint64_t DynamicInvertedIndex::logDeleteLocked(int docid) {
+    IndexWal *wal = wal_;
+    if (!wal) return 0;
+    IndexWal::Record record;
+    record.type = IndexWal::OpType::Delete;
+    record.docid = docid;
+    return wal->append(record);
+}
+
+bool DynamicInvertedIndex::waitDurable(uint64_t lsn) {
+    if (lsn == 0) return true;
+    IndexWal *wal = wal_;
+    if (wal && !wal->waitDurable(lsn)) {
+        std::cerr << "⚠ WAL sync failed, update for lsn " << lsn << " is not durable" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t DynamicInvertedIndex::attachWal(IndexWal *wal) {
+    // 先装入检查点，只重放检查点之后各代的日志
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> merge_lock(merge_mutex_);
+        auto locks = lockAll();
+        loadCheckpointLocked(wal->path() + ".ckpt", generation);
+    }
+
+    // 重放时尚未挂载，记录不会被重复写入日志
+    size_t replayed = wal->replay([this](const IndexWal::Record &record) {
+        if (record.type == IndexWal::OpType::Delete) {
+            removeDocument(record.docid);
+        } else if (record.has_meta) {
+            DocumentMeta meta{record.title, record.link, record.summary, record.text};
+            addTokenized(record.docid, record.tokens, &meta);
+        } else {
+            addTokenized(record.docid, record.tokens, nullptr);
+        }
+    }, generation);
+
+    auto locks = lockAll();
+    wal_ = wal;
+    wal_checkpoint_base_ = wal->sizeBytes();
+    return replayed;
+}
+
+bool DynamicInvertedIndex::checkpoint() {
+    std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+    IndexWal *wal;
+    Snapshot snapshot;
+    uint64_t generation;
+    {
+        // 写入者在所在分区的写锁内应用并追加日志：锁住全部分区后切换日志（只是 rename），
+        // 此刻之前的写入都在各分区的版本里，之后的都在新一代日志里
+        auto locks = lockAll();
+        wal = wal_;
+        if (!wal) return false;
+        generation = wal->rotate();
+        if (generation == 0) return false;
+        snapshot = loadSnapshot();
+        wal_checkpoint_base_ = wal->sizeBytes();
+    }
+
+    // 快照不可变，写盘期间读者和写者都不受影响；失败时上一代日志保留，下次检查点一并覆盖
+    auto start = std::chrono::steady_clock::now();
+    if (!writeCheckpoint(wal->path() + ".ckpt", snapshot, generation)) return false;
+    wal->dropPrevious();
+    checkpoint_ms_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+bool DynamicInvertedIndex::writeCheckpoint(const std::string &path, const Snapshot &snapshot, uint64_t generation) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "✗ Failed to create checkpoint " << tmp << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    CheckpointWriter out(fd);
+    out.append(kCheckpointMagic, sizeof(kCheckpointMagic));
+    out.put(kCheckpointVersion);
+    out.put(generation);
+
+    // 基础文档按 docid 保存，基础索引重建后仍能对上；各分区只屏蔽本分区的文档
+    std::vector<int32_t> masked;
+    for (uint32_t ord = 0; ord < base_ids_.size(); ++ord) {
+        const View &owner = *snapshot[static_cast<size_t>(base_ids_[ord]) % snapshot.size()];
+        if (owner.base_dead && owner.base_dead->test(ord)) masked.push_back(base_ids_[ord]);
+    }
+    out.put(static_cast<uint32_t>(masked.size()));
+    for (int32_t docid : masked) out.put(docid);
+
+    // 段按分区依次写出，格式与分区数无关
+    std::vector<const SegmentRef*> segs;
+    for (const auto &view : snapshot) {
+        for (const auto &ref : view->segments) segs.push_back(&ref);
+    }
+    out.put(static_cast<uint32_t>(segs.size()));
+    for (const SegmentRef *seg_ref : segs) {
+        const SegmentRef &ref = *seg_ref;
+        const Segment &seg = *ref.seg;
+        out.put(seg.id);
+        out.put(static_cast<uint32_t>(seg.docs.size()));
+        for (int docid : seg.docs) out.put(static_cast<int32_t>(docid));
+
+        static const std::vector<uint64_t> no_bits;
+        const auto &bits = ref.dead ? ref.dead->bits : no_bits;
+        out.put(static_cast<uint32_t>(bits.size()));
+        for (uint64_t word : bits) out.put(word);
+
+        // 已删除文档的元数据已释放，不再写出
+        for (uint32_t ord = 0; ord < seg.docs.size(); ++ord) {
+            std::string_view stored;
+            uint32_t raw_len = 0, logical = 0;
+            DocStore::Handle handle = ord < seg.metas.size() ? seg.metas[ord] : 0;
+            if (!handle || ref.isDead(ord) || !store_.readStored(handle, stored, raw_len, logical)) {
+                out.put(kNoMeta);
+                continue;
+            }
+            out.put(static_cast<uint32_t>(stored.size()));
+            out.put(raw_len);
+            out.put(logical);
+            out.append(stored.data(), stored.size());
+        }
+
+        out.put(static_cast<uint32_t>(seg.postings.size()));
+        for (const auto &[term, list] : seg.postings) {
+            out.putBytes(term);
+            out.put(static_cast<uint32_t>(list.size()));
+            for (const auto &[ord, tf] : list) {
+                out.put(ord);
+                out.put(tf);
             }
         }
-        postings = new_postings;
     }
+
+    uint64_t body = out.written();
+    uint32_t crc = out.crc();
+    out.put(body);
+    out.put(crc);
+    out.append(kCheckpointEnd, sizeof(kCheckpointEnd));
+
+    bool ok = out.flush() && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "✗ Failed to write checkpoint " << path << std::endl;
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    syncDir(path);
+    checkpoint_bytes_ = out.written();
+    return true;
 }
 
+bool DynamicInvertedIndex::loadCheckpointLocked(const std::string &path, uint64_t &generation) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    // 整个文件读入内存后解析：倒排列表与元数据都会复制进段和文档存储，
+    // 读入的缓冲在装入后即释放，不必让段长期引用文件内容
+    std::string buf(static_cast<size_t>(st.st_size), '\0');
+    size_t size = 0;
+    while (size < buf.size()) {
+        ssize_t n = ::read(fd, &buf[size], buf.size() - size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        size += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    if (size != buf.size()) {
+        std::cerr << "⚠ Failed to read checkpoint " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    const char *data = buf.data();
+
+    // 解析到临时结构，全部校验通过后才装入；元数据仍指向读入的缓冲
+    struct LoadedSegment {
+        std::shared_ptr<Segment> seg;
+        std::shared_ptr<Tombstones> dead;
+        std::vector<std::string_view> stored;  // 空视图且 raw_len 为 kNoMeta 时表示无元数据
+        std::vector<uint32_t> raw_lens;
+        std::vector<uint32_t> logical;
+    };
+    std::vector<LoadedSegment> loaded;
+    std::vector<int32_t> masked;
+
+    const size_t footer = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(kCheckpointEnd);
+    bool valid = size >= sizeof(kCheckpointMagic) + footer &&
+                 std::memcmp(data, kCheckpointMagic, sizeof(kCheckpointMagic)) == 0 &&
+                 std::memcmp(data + size - sizeof(kCheckpointEnd), kCheckpointEnd, sizeof(kCheckpointEnd)) == 0;
+    if (valid) {
+        uint64_t body;
+        uint32_t crc;
+        std::memcpy(&body, data + size - footer, sizeof(body));
+        std::memcpy(&crc, data + size - footer + sizeof(body), sizeof(crc));
+        valid = body == size - footer && IndexWal::crc32(data, body) == crc;
+    }
+
+    CheckpointReader in(data + sizeof(kCheckpointMagic), valid ? size - footer - sizeof(kCheckpointMagic) : 0);
+    if (valid && in.get<uint32_t>() != kCheckpointVersion) valid = false;
+    if (valid) {
+        generation = in.get<uint64_t>();
+
+        uint32_t n = in.get<uint32_t>();
+        if (in.fits(n, sizeof(int32_t))) {
+            masked.resize(n);
+            for (auto &docid : masked) docid = in.get<int32_t>();
+        }
+
+        uint32_t segments = in.get<uint32_t>();
+        for (uint32_t s = 0; s < segments && in.ok(); ++s) {
+            LoadedSegment ls;
+            ls.seg = std::make_shared<Segment>();
+            Segment &seg = *ls.seg;
+            seg.id = in.get<uint64_t>();
+
+            uint32_t docs = in.get<uint32_t>();
+            if (!in.fits(docs, sizeof(int32_t))) break;
+            seg.docs.resize(docs);
+            for (auto &docid : seg.docs) docid = in.get<int32_t>();
+
+            uint32_t words = in.get<uint32_t>();
+            if (!in.fits(words, sizeof(uint64_t))) break;
+            if (words > 0) {
+                ls.dead = std::make_shared<Tombstones>();
+                ls.dead->bits.resize(words);
+                for (auto &word : ls.dead->bits) {
+                    word = in.get<uint64_t>();
+                    ls.dead->count += static_cast<size_t>(__builtin_popcountll(word));
+                }
+                if (ls.dead->count == 0) ls.dead.reset();
+            }
+
+            ls.stored.resize(docs);
+            ls.raw_lens.assign(docs, kNoMeta);
+            ls.logical.assign(docs, 0);
+            for (uint32_t ord = 0; ord < docs && in.ok(); ++ord) {
+                uint32_t len = in.get<uint32_t>();
+                if (len == kNoMeta) continue;
+                ls.raw_lens[ord] = in.get<uint32_t>();
+                ls.logical[ord] = in.get<uint32_t>();
+                ls.stored[ord] = in.getBytes(len);
+            }
+
+            uint32_t terms = in.get<uint32_t>();
+            seg.postings.reserve(terms);
+            for (uint32_t t = 0; t < terms && in.ok(); ++t) {
+                std::string_view term = in.getBytes();
+                uint32_t count = in.get<uint32_t>();
+                if (!in.fits(count, sizeof(uint32_t) + sizeof(double))) break;
+                auto &list = seg.postings[std::string(term)];
+                list.resize(count);
+                for (auto &entry : list) {
+                    entry.first = in.get<uint32_t>();
+                    entry.second = in.get<double>();
+                    if (entry.first >= docs) in.fail();  // 序号越界
+                }
+            }
+            loaded.push_back(std::move(ls));
+        }
+        valid = in.ok() && loaded.size() == segments;
+    }
+
+    bool empty = true;
+    for (const auto &part : parts_) empty &= loadView(*part)->segments.empty();
+    if (!valid || !empty) {
+        if (!valid) {
+            std::cerr << "⚠ Ignoring invalid checkpoint " << path
+                      << ", updates before it are lost unless the previous WAL is still present" << std::endl;
+        }
+        return false;
+    }
+
+    const size_t n = parts_.size();
+    std::vector<View> next(n);
+    std::vector<TombstoneCopies> copies(n);
+    for (size_t p = 0; p < n; ++p) next[p] = *loadView(*parts_[p]);
+    for (int32_t docid : masked) {
+        if (docid >= 0) maskBaseLocked(docid, next[docid % n], copies[docid % n]);
+    }
+
+    // 按分区归属：写检查点时的分区数与当前不同时，段内文档可能分属多个分区，按分区拆成子段
+    for (const auto &ls : loaded) next_segment_id_ = std::max(next_segment_id_.load(), ls.seg->id + 1);
+    std::vector<std::pair<size_t, LoadedSegment>> routed;
+    for (auto &ls : loaded) {
+        const auto &docs = ls.seg->docs;
+        std::vector<std::vector<uint32_t>> ords(n);
+        for (uint32_t ord = 0; ord < docs.size(); ++ord) {
+            if (docs[ord] >= 0) ords[static_cast<size_t>(docs[ord]) % n].push_back(ord);
+        }
+        auto owner = std::find_if(ords.begin(), ords.end(), [](const auto &o) { return !o.empty(); });
+        if (owner == ords.end()) continue;
+        if (owner->size() == docs.size()) {
+            routed.emplace_back(static_cast<size_t>(owner - ords.begin()), std::move(ls));
+            continue;
+        }
+
+        SegmentRef src{ls.seg, ls.dead};
+        for (size_t p = 0; p < n; ++p) {
+            if (ords[p].empty()) continue;
+            LoadedSegment sub;
+            sub.seg = std::make_shared<Segment>();
+            sub.seg->id = next_segment_id_++;
+            std::vector<int64_t> remap(docs.size(), -1);
+            for (uint32_t ord : ords[p]) {
+                uint32_t new_ord = static_cast<uint32_t>(sub.seg->docs.size());
+                remap[ord] = new_ord;
+                sub.seg->docs.push_back(docs[ord]);
+                sub.stored.push_back(ls.stored[ord]);
+                sub.raw_lens.push_back(ls.raw_lens[ord]);
+                sub.logical.push_back(ls.logical[ord]);
+                if (!src.isDead(ord)) continue;
+                if (!sub.dead) sub.dead = std::make_shared<Tombstones>();
+                sub.dead->bits.resize((ords[p].size() + 63) / 64, 0);
+                sub.dead->bits[new_ord >> 6] |= 1ULL << (new_ord & 63);
+                sub.dead->count++;
+            }
+            // 序号按原顺序重排，倒排列表仍然有序
+            for (const auto &[term, list] : ls.seg->postings) {
+                std::vector<std::pair<uint32_t, double>> out;
+                for (const auto &[ord, tf] : list) {
+                    if (remap[ord] >= 0) out.push_back({static_cast<uint32_t>(remap[ord]), tf});
+                }
+                if (!out.empty()) sub.seg->postings.emplace(term, std::move(out));
+            }
+            routed.emplace_back(p, std::move(sub));
+        }
+    }
+
+    // 装入：元数据追加到文档存储，再建立每文档状态与词典
+    for (auto &[p, ls] : routed) {
+        Partition &part = *parts_[p];
+        Segment &seg = *ls.seg;
+        seg.metas.assign(seg.docs.size(), 0);
+        for (uint32_t ord = 0; ord < seg.docs.size(); ++ord) {
+            if (ls.raw_lens[ord] == kNoMeta) continue;
+            seg.metas[ord] = store_.appendStored(ls.stored[ord], ls.raw_lens[ord], ls.logical[ord]);
+        }
+
+        SegmentRef ref{ls.seg, ls.dead};
+        for (uint32_t ord = 0; ord < seg.docs.size(); ++ord) {
+            if (ref.isDead(ord)) continue;
+            DocState &state = docStateLocked(part, seg.docs[ord]);
+            state.seg = &seg;
+            state.ord = ord;
+        }
+        // 更新只需要旧版本的词（用于缓存失效），由倒排列表还原
+        for (const auto &[term, list] : seg.postings) {
+            uint32_t id = internTermLocked(part, term);
+            for (const auto &entry : list) {
+                if (!ref.isDead(entry.first)) docStateLocked(part, seg.docs[entry.first]).tokens.push_back(id);
+            }
+        }
+        next[p].stored_docs += seg.docs.size();
+        next[p].segments.push_back(std::move(ref));
+    }
+    buf = std::string();
+
+    for (auto &part : parts_) {
+        for (auto &state : part->docs) {
+            if (state.tokens.empty()) continue;
+            state.tokens.shrink_to_fit();
+            uint64_t legacy = sizeof(std::vector<std::string>);
+            for (uint32_t id : state.tokens) legacy += stringBytes(part->terms[id]);
+            token_bytes_ += sizeof(state.tokens) + state.tokens.capacity() * sizeof(uint32_t);
+            token_legacy_bytes_ += legacy;
+        }
+    }
+
+    for (size_t p = 0; p < n; ++p) publishLocked(*parts_[p], std::move(next[p]));
+    checkpoint_bytes_ = size;
+    return true;
+}
+
+void DynamicInvertedIndex::setChangeListener(ChangeListener listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    listener_ = std::move(listener);
+}
+
+bool DynamicInvertedIndex::collectOldTerms(Partition &part, int docid, std::vector<std::string> &terms) const {
+    if (const DocState *state = findDocLocked(part, docid)) {
+        for (uint32_t id : state->tokens) terms.push_back(part.terms[id]);
+        return true;
+    }
+    // 基础索引中的文档没有保存分词结果；已删除或不存在的文档不会出现在结果中，无需失效
+    return !baseLive(docid, *loadView(part));
+}
+
+void DynamicInvertedIndex::notifyChange(std::vector<std::string> terms, bool all) const {
+    ChangeListener listener;
+    {
+        std::lock_guard<std::mutex> lock(listener_mutex_);
+        listener = listener_;
+    }
+    if (!listener) return;
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    listener(terms, all);
+}
+
+std::vector<std::string> DynamicInvertedIndex::tokenize(const std::string &text) const {
+    // 使用JiebaTokenizer分词
+    std::vector<std::string> tokens;
+    JiebaTokenizer::instance().tokenize(text, tokens);
+    return tokens;
+}
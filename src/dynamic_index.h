@@ -1,23 +1,66 @@
 #pragma once
 #include "weighted_inverted_index.h"
+#include "index_wal.h"
+#include "doc_store.h"
 #include <mutex>
-#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 #include <atomic>
+#include <memory>
 #include <unordered_set>
+#include <functional>
+
+class ThreadPool;
 
 /**
  * 动态倒排索引 - 支持实时增删改
- * 
+ *
  * 特性：
  * 1. 支持动态添加/删除文档
- * 2. 自动重新计算TF-IDF
- * 3. 线程安全
- * 4. 支持持久化
+ * 2. 分段存储：每次写入生成一个小的不可变段，段内文档按 docid 排序
+ * 3. 后台线程按分层策略合并段，并清理删除标记过多的段；合并按速率/CPU 预算限速
+ * 4. 快照读：读者原子地取得当前版本（段列表 + 删除位图），全程不加写者会持有的锁；
+ *    写者串行构建新版本，以一次原子指针替换发布（RCU）
+ * 5. 支持持久化：挂载 WAL 后每次写入先追加日志（组提交）；检查点把某一时刻的快照写成二进制文件，
+ *    重启时读入并校验检查点，再重放其后的日志
+ * 6. 基础 + 增量覆盖：直接引用静态服务已加载的 WeightedInvertedIndex（不再复制一份），
+ *    基础文档被删除或更新时在快照的基础位图上屏蔽；查询合并两者的 DF/N，一次打分取 top-k
+ * 7. 按 docid 哈希分区（docid % 分区数）：每个分区有自己的写锁、段、删除位图与每文档状态，
+ *    不同分区的写入互不等待，一批写入按分区拆开并行应用；查询取得各分区的版本，
+ *    DF/N 为各分区之和（全局统计），打分结果与不分区时一致。
+ *    同一文档总在同一分区，其写入顺序不变；跨分区的同一批写入不保证同时可见
+ *
+ * 每个文档只在基础索引或一个段中存活；删除只在所在段的位图上打标记（写时复制），合并时真正移除。
+ * 倒排列表只保存归一化 TF（与基础索引相同的 0.5 + 0.5 * tf/max_tf），IDF 在查询时由快照中的 DF/N 计算：
+ * 增删文档只改动该文档自身的词，无需全局重算权重。
+ *
+ * 元数据编码后追加到 DocStore（分块 arena，可压缩），段内只保存 8 字节句柄；
+ * 更新路径需要的旧分词结果以词 ID 序列保存，词典只增不减。
+ *
+ * docid 为 DocIdMap 分配的稠密内部 ID（非负），写者侧的每文档状态是各分区内按 docid / 分区数 下标的平坦数组。
  */
 class DynamicInvertedIndex {
 public:
-    DynamicInvertedIndex() = default;
-    
+    // 合并参数
+    struct Options {
+        size_t merge_factor = 10;        // 同一层级段数达到该值时合并
+        double expunge_ratio = 0.2;      // 段内删除比例超过该值时单独重写
+        size_t merge_rate_limit = 0;     // 合并速率上限（倒排项/秒，0 不限）
+        int merge_cpu_percent = 100;     // 合并线程占用单核 CPU 的上限（百分比）
+        uint64_t wal_checkpoint_bytes = 0;  // WAL 自上次检查点增长超过该字节数时自动检查点（0 关闭）
+        bool store_text = false;         // 元数据是否保留全文（仅摘要生成需要）
+        bool compress_docs = true;       // 元数据记录 LZ4 压缩（需 ENABLE_LZ4=1 编译）
+        size_t partitions = 1;           // 分区数（按 docid 哈希），批量写入按分区并行应用
+    };
+
+    DynamicInvertedIndex() : DynamicInvertedIndex(Options()) {}
+    explicit DynamicInvertedIndex(const Options &opts);
+    ~DynamicInvertedIndex();
+
+    DynamicInvertedIndex(const DynamicInvertedIndex&) = delete;
+    DynamicInvertedIndex& operator=(const DynamicInvertedIndex&) = delete;
+
     // 文档元数据结构
     struct DocumentMeta {
         std::string title;
@@ -25,69 +68,300 @@ public:
         std::string summary;
         std::string text;  // 完整文本
     };
-    
-    // 从文件加载基础索引
-    bool loadFromFile(const std::string &index_path, size_t total_docs_count);
-    
-    // 添加单个文档（自动更新IDF）
+
+    // 挂载基础索引（不复制）：须在任何写入之前调用，base 生命周期长于本对象
+    void attachBase(const WeightedInvertedIndex &base);
+
+    // 添加单个文档
     void addDocument(int docid, const std::string &text);
-    
+
     // 添加文档（带元数据）
     void addDocument(int docid, const DocumentMeta &meta);
-    
+
+    // 添加已分词的文档（meta 可为空，为空时保留已有元数据）
+    void addTokenized(int docid, const std::vector<std::string> &tokens, const DocumentMeta *meta);
+
     // 批量添加文档
     void addDocuments(const std::vector<std::pair<int, std::string>> &documents);
-    
+
+    // 一条已分词的写操作
+    struct Update {
+        int docid = 0;
+        bool remove = false;                          // true 为删除，忽略 tokens/meta
+        std::vector<std::string> tokens;
+        std::shared_ptr<const DocumentMeta> meta;     // 为空时保留已有元数据
+    };
+
+    // 按顺序应用一批写操作：按分区拆开并行应用，每个分区一次发布新版本，整批共享一次 WAL 落盘等待；
+    // 返回整批是否已落盘（未挂载 WAL 时总为 true）。返回 false 时写入已可见，但重启后可能丢失
+    bool applyBatch(const std::vector<Update> &updates);
+
     // 获取文档元数据
     bool getDocumentMeta(int docid, DocumentMeta &meta) const;
-    
-    // 删除文档（标记删除，不立即重建索引）
+
+    // 文档是否存活（未被屏蔽的基础文档，或某个段中未删除的版本）
+    bool contains(int docid) const;
+
+    // 逐分区加锁遍历增量部分的存活文档及其词（写入时的分词结果；由检查点恢复的文档为去重后的词），
+    // 没有分词结果的文档跳过；回调在分区写锁内执行，不能再写入本索引
+    void forEachDocTerms(const std::function<void(int docid, const std::vector<std::string> &terms)> &fn) const;
+
+    // 删除文档（标记删除，由后台合并清理）
     void removeDocument(int docid);
-    
-    // 更新文档（先删后加）
+
+    // 更新文档（替换旧版本）
     void updateDocument(int docid, const std::string &new_text);
-    
-    // 搜索接口（与原WeightedInvertedIndex兼容）
+
+    // 搜索接口（与原WeightedInvertedIndex兼容）：基础索引与各段统一打分，
+    // top_k > 0 时只保留得分最高的 top_k 条
     std::vector<std::pair<int, double>> searchANDCosineRanked(
-        const std::vector<std::string> &terms) const;
-    
+        const std::vector<std::string> &terms, size_t top_k = 0) const;
+
     // 获取索引统计
     struct Stats {
-        size_t total_docs;
+        size_t total_docs;       // 基础文档 + 各段文档
         size_t active_docs;      // 未被删除的文档数
-        size_t deleted_docs;     // 已删除的文档数
+        size_t deleted_docs;     // 已删除的文档数（含被屏蔽的基础文档）
         size_t total_terms;      // 词汇表大小
-        size_t pending_updates;  // 待处理的更新数
+        size_t pending_updates;  // 位于最低层（尚未参与合并）小段中的文档数
+        size_t segments;         // 段数（各分区之和）
+        size_t partitions;       // 分区数
+        size_t merges;           // 已完成的合并次数
+        bool merging;            // 是否正在合并
+        size_t merge_done;       // 当前合并已处理的倒排项
+        size_t merge_total;      // 当前合并的倒排项总数
+        size_t doc_records;      // 文档存储中的存活记录数
+        uint64_t doc_store_bytes;   // 文档存储已分配的内存
+        uint64_t doc_dead_bytes;    // 文档存储中已失效、待重启回收的字节
+        uint64_t token_bytes;       // 更新用的词 ID 序列占用
+        size_t dict_terms;          // 词典大小
+        uint64_t memory_saved;      // 相比逐文档保存字符串（元数据 + 分词结果）估算节省的内存
+        uint64_t checkpoint_bytes;  // 最近一次检查点文件大小
+        uint64_t checkpoint_ms;     // 最近一次检查点写盘耗时
     };
     Stats getStats() const;
-    
+
     // 持久化到文件
     bool saveToFile(const std::string &index_path) const;
-    
-    // 清理删除的文档（重建索引）
+
+    // 加载 WAL 旁的检查点（<wal>.ckpt，若有）并重放其后的日志，然后挂载，
+    // 此后的写入都会先追加到日志；返回重放的记录数。
+    // 须在 attachBase 之后、任何写入之前调用；wal 需已 open()，且生命周期长于本对象
+    size_t attachWal(IndexWal *wal);
+
+    // 检查点：写锁内只切换到新一代日志并取得当前快照，随后在锁外把快照
+    // （段、倒排、删除位图、被屏蔽的基础文档、元数据记录）写成二进制文件，
+    // 完成后删除上一代日志；查询与写入都不等待写盘
+    bool checkpoint();
+
+    // 清理删除的文档：把所有段合并为一个（同步执行）
     void compact();
-    
+
+    // 请求后台线程执行 compact()，立即返回
+    void requestCompaction();
+
     // 是否需要压缩（删除文档过多时）
     bool needsCompaction() const;
-    
+
+    // 索引变更通知（用于缓存失效），在新版本发布后调用：
+    // all=false 时 terms 为受影响的词；无法确定受影响的词时 all=true
+    using ChangeListener = std::function<void(const std::vector<std::string> &terms, bool all)>;
+    void setChangeListener(ChangeListener listener);
+
 private:
+    // 不可变段：docs 按 docid 升序，下标即段内序号；
+    // postings 中每个词的倒排列表为 (序号, TF)，按序号升序
+    struct Segment {
+        uint64_t id = 0;
+        std::vector<int> docs;
+        std::unordered_map<std::string, std::vector<std::pair<uint32_t, double>>> postings;
+        std::vector<DocStore::Handle> metas;  // 按序号，0 表示没有元数据
+
+        // 返回 docid 的序号，不存在时返回 -1
+        long find(int docid) const;
+    };
+    using SegmentPtr = std::shared_ptr<const Segment>;
+
+    // 删除位图：按段内序号，写时复制
+    struct Tombstones {
+        std::vector<uint64_t> bits;
+        size_t count = 0;
+
+        bool test(uint32_t ord) const {
+            return (ord >> 6) < bits.size() && ((bits[ord >> 6] >> (ord & 63)) & 1);
+        }
+    };
+
+    struct SegmentRef {
+        SegmentPtr seg;
+        std::shared_ptr<const Tombstones> dead;  // 为空表示没有删除
+
+        bool isDead(uint32_t ord) const { return dead && dead->test(ord); }
+        size_t deadCount() const { return dead ? dead->count : 0; }
+        size_t liveDocs() const { return seg->docs.size() - deadCount(); }
+    };
+
+    // 读者看到的一个版本，发布后不再修改
+    struct View {
+        std::vector<SegmentRef> segments;
+        size_t stored_docs = 0;  // 各段文档数之和（含未清理的删除），N 另加基础文档数
+        std::shared_ptr<const Tombstones> base_dead;  // 基础文档屏蔽位图（按 base_ids_ 下标，只含本分区的文档）
+    };
+    using ViewPtr = std::shared_ptr<const View>;
+
+    // 写者侧的每文档状态，按 docid / 分区数 下标存放
+    struct DocState {
+        const Segment *seg = nullptr;  // 存活版本所在的段，为空表示不在任何段中
+        uint32_t ord = 0;
+        std::vector<uint32_t> tokens;  // 词 ID 序列（用于更新时的缓存失效；从检查点恢复的为去重后的词）
+    };
+
+    struct PendingDoc {
+        int docid;
+        const std::vector<std::string> *tokens;
+        const DocumentMeta *meta;  // 为空时沿用旧版本的元数据
+    };
+
+    // 一个分区：docid % 分区数 相同的文档
+    struct Partition {
+        mutable std::mutex write_mutex;  // 串行化本分区的写入与合并发布
+        ViewPtr view;                    // 读者用 atomic_load 取得，写者用 atomic_store 发布
+        // 以下受 write_mutex 保护
+        std::vector<DocState> docs;                          // docid / 分区数 -> 所在段与词 ID 序列
+        std::unordered_map<std::string, uint32_t> term_ids;  // 词典：词 -> ID（只增不减）
+        std::vector<std::string> terms;                      // 词典：ID -> 词
+    };
+
+    // 各分区当前版本（下标为分区号），读者唯一的同步点
+    using Snapshot = std::vector<ViewPtr>;
+
+    Partition &partitionOf(int docid) const { return *parts_[static_cast<size_t>(docid) % parts_.size()]; }
+    ViewPtr loadView(const Partition &part) const { return std::atomic_load(&part.view); }
+    Snapshot loadSnapshot() const;
+
+    // 按分区号顺序锁住所有分区（attachBase/attachWal/检查点等需要全局一致的场合）
+    std::vector<std::unique_lock<std::mutex>> lockAll() const;
+
     // 分词函数
     std::vector<std::string> tokenize(const std::string &text) const;
-    
-    // 计算TF-IDF
-    void computeTFIDF(int docid, const std::vector<std::string> &tokens);
-    
-    // 重新计算IDF（添加/删除文档后）
-    void recomputeIDF();
-    
-    // 核心数据结构
-    InvertIndexTable postings_;
-    std::unordered_set<int> deleted_docs_;  // 已删除的文档ID
-    std::unordered_map<int, std::vector<std::string>> doc_tokens_;  // 文档->分词结果（用于更新）
-    std::unordered_map<int, DocumentMeta> doc_metadata_;  // 文档元数据
-    
-    size_t total_docs_ = 0;
-    
-    mutable std::shared_mutex mutex_;  // 读写锁
-};
 
+    // 以一批文档构建新段（同一 docid 取最后一次），handles 为各文档的元数据句柄
+    std::shared_ptr<Segment> buildSegment(const std::vector<PendingDoc> &docs,
+                                          const std::vector<DocStore::Handle> &handles);
+
+    // copies 记录构建 next 时已复制过的位图，同一段只复制一次（基础位图的键为 nullptr）
+    using TombstoneCopies = std::unordered_map<const Segment*, std::shared_ptr<Tombstones>>;
+
+    // 在一个分区内按顺序应用写操作并发布（加该分区的写锁），返回最后一条日志的 LSN
+    uint64_t applyPartition(Partition &part, const std::vector<const Update*> &updates,
+                            std::vector<std::string> &changed, bool &all);
+
+    // 把一批文档写入 next（调用方持有 part.write_mutex），旧版本在所在段标记删除
+    void addBatchLocked(Partition &part, const std::vector<PendingDoc> &docs, View &next, TombstoneCopies &copies);
+
+    // 在 next 中标记删除（调用方持有 part.write_mutex），返回文档是否存在
+    bool deleteLocked(Partition &part, int docid, View &next, TombstoneCopies &copies);
+
+    // 在 next 中屏蔽基础文档，返回此前是否可见
+    bool maskBaseLocked(int docid, View &next, TombstoneCopies &copies);
+
+    // 基础文档在 base_ids_ 中的下标，不存在时返回 -1
+    long baseOrd(int docid) const;
+    // view 为 docid 所在分区的版本
+    bool baseLive(int docid, const View &view) const;
+
+    // 删除文档并释放其元数据与分词结果（调用方持有 part.write_mutex）
+    bool removeLocked(Partition &part, int docid, View &next, TombstoneCopies &copies);
+
+    // 元数据编解码；不保留全文时 text 写为空
+    DocStore::Handle storeMeta(const DocumentMeta &meta);
+    bool loadMeta(DocStore::Handle handle, DocumentMeta &meta) const;
+
+    // 存活的动态文档，不存在时返回 nullptr（调用方持有 part.write_mutex）
+    DocState *findDocLocked(Partition &part, int docid) const;
+    // 取得（必要时扩容）docid 的状态，docid 须非负
+    DocState &docStateLocked(Partition &part, int docid) const;
+
+    // 分词结果转为词 ID 序列（调用方持有 part.write_mutex）
+    uint32_t internTermLocked(Partition &part, const std::string &term);
+    void setDocTokensLocked(Partition &part, int docid, const std::vector<std::string> &tokens);
+    void eraseDocTokensLocked(Partition &part, int docid);
+
+    // 发布分区的新版本（调用方持有 part.write_mutex）
+    void publishLocked(Partition &part, View next);
+
+    // 合并同一分区的段：在锁外构建新段，再在该分区的写锁内替换源段并补上合并期间的删除；
+    // 停止时放弃并返回 false
+    bool mergeSegments(Partition &part, const std::vector<SegmentRef> &sources);
+
+    // 按速率与 CPU 预算暂停合并，返回 false 表示需要停止
+    bool throttleMerge(std::chrono::steady_clock::time_point &chunk_start, size_t work);
+
+    // 按分层策略挑选待合并的段
+    std::vector<SegmentRef> pickMerge(const View &view) const;
+
+    // 后台合并线程
+    void mergeLoop();
+    void requestMerge();
+
+    // 把各分区的版本写成检查点文件（临时文件 + rename），不需要持有写锁
+    bool writeCheckpoint(const std::string &path, const Snapshot &snapshot, uint64_t generation);
+
+    // 读入检查点、校验长度与 CRC 后装入（调用方持有 merge_mutex_ 与全部分区的写锁，且尚未写入）；
+    // 段内文档分属多个分区（分区数变化）时按分区拆开；
+    // 文件不存在或无效时返回 false，generation 为检查点之后的第一代日志
+    bool loadCheckpointLocked(const std::string &path, uint64_t &generation);
+
+    // 追加 WAL 记录（调用方持有文档所在分区的写锁），未挂载时返回 0
+    uint64_t logAddLocked(int docid, const std::vector<std::string> &tokens, const DocumentMeta *meta);
+    uint64_t logDeleteLocked(int docid);
+
+    // 等待 lsn 落盘（锁外调用），写盘失败时返回 false
+    bool waitDurable(uint64_t lsn);
+
+    // 收集文档旧版本的词（用于变更通知，调用方持有 part.write_mutex），
+    // 返回 false 表示无法确定（基础索引中的文档）
+    bool collectOldTerms(Partition &part, int docid, std::vector<std::string> &terms) const;
+    void notifyChange(std::vector<std::string> terms, bool all) const;
+
+    Options opts_;
+
+    // 分区（构造后数量不变）
+    std::vector<std::unique_ptr<Partition>> parts_;
+    std::unique_ptr<ThreadPool> apply_pool_;  // 批量写入时并行应用各分区（分区数为 1 时为空）
+
+    // 基础索引（只读，挂载后不再变化，读者无需加锁）
+    const WeightedInvertedIndex *base_ = nullptr;
+    std::vector<int> base_ids_;  // 基础文档 ID（升序，没有分词结果）
+    size_t base_docs_ = 0;       // 基础索引的 N（构建权重时使用）
+
+    std::atomic<uint64_t> next_segment_id_{1};
+    mutable std::mutex listener_mutex_;
+    ChangeListener listener_;
+    std::atomic<IndexWal*> wal_{nullptr};           // 持有全部分区写锁时挂载
+    std::atomic<uint64_t> wal_checkpoint_base_{0};  // 上次检查点后的日志大小
+
+    std::mutex checkpoint_mutex_;  // 同一时刻只写一个检查点（自动或 /index/save）
+    std::atomic<uint64_t> checkpoint_bytes_{0};
+    std::atomic<uint64_t> checkpoint_ms_{0};
+
+    // 元数据存储（读者无锁读取）与内存统计
+    DocStore store_;
+    std::atomic<uint64_t> token_bytes_{0};         // 词 ID 序列占用
+    std::atomic<uint64_t> token_legacy_bytes_{0};  // 同样内容按字符串向量保存的估算占用
+    std::atomic<uint64_t> dict_bytes_{0};
+    std::atomic<size_t> dict_terms_{0};
+
+    // 合并线程；merge_mutex_ 保证同一时刻只有一个合并（后台或 compact）
+    std::mutex merge_mutex_;
+    std::mutex merge_wait_mutex_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool compact_requested_ = false;
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> merges_{0};
+    std::atomic<bool> merge_running_{false};
+    std::atomic<size_t> merge_done_{0};
+    std::atomic<size_t> merge_total_{0};
+    std::thread merge_thread_;
+};
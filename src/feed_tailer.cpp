@@ -0,0 +1,235 @@
+#include "feed_tailer.h"
+#include <wfrest/json.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    // 解析一行记录，格式错误时返回 false；docid 以外部 key 返回，由调用方映射
+    bool parseRecord(const std::string &line, IngestQueue::Request &request, std::string &key) {
+        json record = json::parse(line, nullptr, false);
+        if (record.is_discarded() || !record.is_object() || !record.contains("docid")) {
+            return false;
+        }
+        const json &docid = record["docid"];
+        if (docid.is_number_integer()) {
+            key = docid.dump();
+        } else if (docid.is_string() && !docid.get<std::string>().empty()) {
+            key = docid.get<std::string>();
+        } else {
+            return false;
+        }
+
+        std::string op = record.value("op", "add");
+        if (op == "delete") {
+            request.remove = true;
+            return true;
+        }
+        if ((op != "add" && op != "update") || !record.contains("text") || !record["text"].is_string()) {
+            return false;
+        }
+        request.text = record["text"];
+        if (record.contains("title") || record.contains("link")) {
+            auto meta = std::make_shared<DynamicInvertedIndex::DocumentMeta>();
+            meta->title = record.value("title", "");
+            meta->link = record.value("link", "");
+            meta->summary = record.value("summary", "");
+            meta->text = request.text;
+            request.meta = std::move(meta);
+        }
+        return true;
+    }
+}
+
+FeedTailer::FeedTailer(IngestQueue &queue, DocIdMap &doc_ids, const Options &opts)
+    : queue_(queue), doc_ids_(doc_ids), opts_(opts) {
+    if (opts_.offset_path.empty()) opts_.offset_path = opts_.path + ".offset";
+    if (opts_.poll_interval_ms < 1) opts_.poll_interval_ms = 1;
+    if (opts_.batch_size == 0) opts_.batch_size = 1;
+}
+
+FeedTailer::~FeedTailer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (runner_.joinable()) runner_.join();
+}
+
+void FeedTailer::start() {
+    uint64_t offset = loadOffset();
+    offset_ = offset;
+    applied_offset_ = offset;
+    runner_ = std::thread(&FeedTailer::run, this);
+}
+
+uint64_t FeedTailer::loadOffset() const {
+    std::ifstream fin(opts_.offset_path);
+    uint64_t offset = 0;
+    if (fin >> offset) return offset;
+    return 0;
+}
+
+bool FeedTailer::saveOffset(uint64_t offset) const {
+    // 临时文件 + rename，偏移量文件不会写坏；未落盘只会导致重读，不会丢记录
+    std::string tmp = opts_.offset_path + ".tmp";
+    {
+        std::ofstream fout(tmp, std::ios::trunc);
+        if (!(fout << offset << "\n")) return false;
+    }
+    return std::rename(tmp.c_str(), opts_.offset_path.c_str()) == 0;
+}
+
+void FeedTailer::commitApplied() {
+    // 只提交已落盘的批次：已应用但 WAL 落盘失败的记录在重启后会丢失，需要重读
+    uint64_t durable_seq = queue_.getStats().durable_seq;
+    uint64_t committed = applied_offset_;
+    while (!inflight_.empty() && inflight_.front().first <= durable_seq) {
+        committed = inflight_.front().second;
+        inflight_.pop_front();
+    }
+    // 没有未确认的批次时，已读取的位置（包括跳过的空行、坏行）都可提交
+    if (inflight_.empty()) committed = offset_;
+    if (committed != applied_offset_ && saveOffset(committed)) {
+        applied_offset_ = committed;
+    }
+}
+
+uint64_t FeedTailer::readLines(int fd, uint64_t offset, std::vector<IngestQueue::Request> &requests) {
+    // 只消费以换行结尾的完整行，写了一半的尾行留到下次
+    std::string pending;
+    uint64_t read_pos = offset;
+    uint64_t consumed = offset;
+    std::vector<std::string> keys;
+    char buf[64 * 1024];
+    while (requests.size() < opts_.batch_size) {
+        ssize_t n = ::pread(fd, buf, sizeof(buf), static_cast<off_t>(read_pos));
+        if (n <= 0) break;
+        read_pos += static_cast<uint64_t>(n);
+        pending.append(buf, static_cast<size_t>(n));
+
+        size_t start = 0;
+        size_t newline;
+        while (requests.size() < opts_.batch_size &&
+               (newline = pending.find('\n', start)) != std::string::npos) {
+            std::string line = pending.substr(start, newline - start);
+            start = newline + 1;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+            IngestQueue::Request request;
+            std::string key;
+            if (parseRecord(line, request, key)) {
+                requests.push_back(std::move(request));
+                keys.push_back(std::move(key));
+            } else {
+                errors_++;
+            }
+        }
+        consumed += start;
+        pending.erase(0, start);
+    }
+    if (requests.empty()) return consumed;
+
+    // 外部 ID -> 内部 ID：先整批分配写入的 key（只落盘一次），
+    // 再查找删除的 key，同批内先写后删也能找到
+    std::vector<std::string> add_keys;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!requests[i].remove) add_keys.push_back(keys[i]);
+    }
+    std::vector<uint32_t> ids;
+    if (!doc_ids_.assign(add_keys, ids)) {
+        // 映射无法落盘：整批放弃，稍后从同一位置重读
+        requests.clear();
+        return offset;
+    }
+    size_t next_add = 0;
+    size_t out = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        uint32_t id = 0;
+        if (!requests[i].remove) {
+            id = ids[next_add++];
+        } else if (!doc_ids_.find(keys[i], id)) {
+            continue;  // 删除从未写入的文档，无事可做
+        }
+        requests[i].docid = static_cast<int>(id);
+        if (out != i) requests[out] = std::move(requests[i]);
+        out++;
+    }
+    requests.resize(out);
+    return consumed;
+}
+
+void FeedTailer::run() {
+    const auto interval = std::chrono::milliseconds(opts_.poll_interval_ms);
+    int fd = -1;
+    std::vector<IngestQueue::Request> batch;
+    uint64_t batch_end = 0;
+
+    while (true) {
+        bool idle = false;
+        commitApplied();
+
+        if (fd < 0) {
+            fd = ::open(opts_.path.c_str(), O_RDONLY);
+        }
+        if (fd < 0) {
+            idle = true;
+        } else {
+            struct stat st;
+            if (fstat(fd, &st) == 0) {
+                file_bytes_ = static_cast<uint64_t>(st.st_size);
+                // 文件被截断：从头重新读取
+                if (file_bytes_ < offset_) {
+                    std::cerr << "Feed " << opts_.path << " truncated, restarting from offset 0" << std::endl;
+                    batch.clear();
+                    inflight_.clear();
+                    offset_ = 0;
+                    applied_offset_ = 0;
+                    saveOffset(0);
+                }
+            }
+
+            if (batch.empty()) {
+                batch_end = readLines(fd, offset_, batch);
+                if (batch.empty()) {
+                    // 只有空行或坏行时同样前移
+                    idle = batch_end == offset_;
+                    offset_ = batch_end;
+                }
+            }
+
+            if (!batch.empty()) {
+                size_t count = batch.size();
+                uint64_t seq = queue_.submit(std::move(batch));
+                if (seq == 0) {
+                    // 背压：索引跟不上时保留本批，稍后重试
+                    throttled_++;
+                    idle = true;
+                } else {
+                    records_ += count;
+                    offset_ = batch_end;
+                    inflight_.push_back({seq, batch_end});
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (idle) cv_.wait_for(lock, interval, [this]() { return stopping_; });
+        if (stopping_) break;
+    }
+
+    if (fd >= 0) ::close(fd);
+    commitApplied();
+}
+
+FeedTailer::Stats FeedTailer::getStats() const {
+    return {offset_.load(), applied_offset_.load(), file_bytes_.load(),
+            records_.load(), errors_.load(), throttled_.load()};
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "ingest_queue.h"
+#include "doc_id_map.h"
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// 追加写 JSONL 文件的写入源
+//
+// 每行一条记录：{"op":"add|update|delete","docid":1 或 "key","text":"...","title":"...","link":"...","summary":"..."}
+// （op 缺省为 add；提供 title/link 时写入元数据；docid 经 DocIdMap 映射为内部 ID，
+// 删除未知 docid 的记录直接跳过）
+// - 从持久化的偏移量开始读取完整行，按批提交到 IngestQueue
+// - 队列已满（索引跟不上）时暂停读取并重试同一批，不丢记录
+// - 只有在该批已应用且已写入 WAL 落盘（IngestQueue 的 durable_seq）后才持久化偏移量：
+//   崩溃后从最后一个已落盘的位置重读，记录按 docid 幂等，重复应用无副作用
+class FeedTailer {
+public:
+    struct Options {
+        std::string path;              // JSONL 文件
+        std::string offset_path;       // 偏移量文件（空则为 path + ".offset"）
+        int poll_interval_ms = 200;    // 没有新数据或队列已满时的等待间隔
+        size_t batch_size = 512;       // 每批提交的记录数
+    };
+
+    struct Stats {
+        uint64_t offset;          // 已读取到的字节位置
+        uint64_t applied_offset;  // 已应用并落盘（偏移量已持久化）的字节位置
+        uint64_t file_bytes;      // 文件当前大小
+        uint64_t records;         // 已提交的记录数
+        uint64_t errors;          // 无法解析的行数
+        uint64_t throttled;       // 因队列已满而等待的次数
+    };
+
+    FeedTailer(IngestQueue &queue, DocIdMap &doc_ids, const Options &opts);
+    ~FeedTailer();
+
+    FeedTailer(const FeedTailer&) = delete;
+    FeedTailer& operator=(const FeedTailer&) = delete;
+
+    // 读取持久化的偏移量并启动读取线程
+    void start();
+
+    Stats getStats() const;
+
+private:
+    void run();
+
+    // 读取 [offset, ...) 中的完整行，返回解析出的请求与下一行的起始位置
+    uint64_t readLines(int fd, uint64_t offset, std::vector<IngestQueue::Request> &requests);
+
+    // 持久化已应用批次中最大的偏移量
+    void commitApplied();
+    bool saveOffset(uint64_t offset) const;
+    uint64_t loadOffset() const;
+
+    IngestQueue &queue_;
+    DocIdMap &doc_ids_;
+    Options opts_;
+
+    // 已提交、尚未确认应用的批次：(最后一条的序号, 批次结束偏移)
+    std::deque<std::pair<uint64_t, uint64_t>> inflight_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread runner_;
+
+    std::atomic<uint64_t> offset_{0};
+    std::atomic<uint64_t> applied_offset_{0};
+    std::atomic<uint64_t> file_bytes_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> throttled_{0};
+};
@@ -576,7 +576,7 @@ int main(int argc, char **argv) {
                             }
                             
                             response["index_data"] = {
-                                {"docid", std::hash<std::string>{}(hash)},
+                                {"docid", hash},
                                 {"title", filename},
                                 {"link", "/api/file/download/" + hash},
                                 {"summary", "文件: " + filename},
@@ -587,7 +587,7 @@ int main(int argc, char **argv) {
                     // 非文本文件：只索引文件名
                     else {
                         response["index_data"] = {
-                            {"docid", std::hash<std::string>{}(hash)},
+                            {"docid", hash},
                             {"title", filename},
                             {"link", "/api/file/download/" + hash},
                             {"summary", "文件: " + filename + " (" + ext + ")"},
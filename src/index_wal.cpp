@@ -0,0 +1,370 @@
+#include "index_wal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+namespace {
+    void putU32(std::string &out, uint32_t v) {
+        char b[4];
+        std::memcpy(b, &v, 4);
+        out.append(b, 4);
+    }
+
+    void putU64(std::string &out, uint64_t v) {
+        char b[8];
+        std::memcpy(b, &v, 8);
+        out.append(b, 8);
+    }
+
+    void putStr(std::string &out, const std::string &s) {
+        putU32(out, static_cast<uint32_t>(s.size()));
+        out += s;
+    }
+
+    bool getU32(const char *&p, const char *end, uint32_t &v) {
+        if (end - p < 4) return false;
+        std::memcpy(&v, p, 4);
+        p += 4;
+        return true;
+    }
+
+    bool getU64(const char *&p, const char *end, uint64_t &v) {
+        if (end - p < 8) return false;
+        std::memcpy(&v, p, 8);
+        p += 8;
+        return true;
+    }
+
+    bool getStr(const char *&p, const char *end, std::string &s) {
+        uint32_t len;
+        if (!getU32(p, end, len) || static_cast<size_t>(end - p) < len) return false;
+        s.assign(p, len);
+        p += len;
+        return true;
+    }
+
+    // 记录：[u32 载荷长度][u32 CRC32][载荷]
+    void encodeRecord(std::string &out, const IndexWal::Record &r) {
+        std::string payload;
+        payload.push_back(static_cast<char>(r.type));
+        putU32(payload, static_cast<uint32_t>(r.docid));
+        if (r.type == IndexWal::OpType::Marker) {
+            putU64(payload, r.generation);
+        } else if (r.type == IndexWal::OpType::Add) {
+            payload.push_back(r.has_meta ? 1 : 0);
+            if (r.has_meta) {
+                putStr(payload, r.title);
+                putStr(payload, r.link);
+                putStr(payload, r.summary);
+                putStr(payload, r.text);
+            }
+            putU32(payload, static_cast<uint32_t>(r.tokens.size()));
+            for (const auto &t : r.tokens) putStr(payload, t);
+        }
+        putU32(out, static_cast<uint32_t>(payload.size()));
+        putU32(out, IndexWal::crc32(payload.data(), payload.size()));
+        out += payload;
+    }
+
+    bool decodePayload(const char *p, const char *end, IndexWal::Record &r) {
+        if (p == end) return false;
+        r.type = static_cast<IndexWal::OpType>(*p++);
+        uint32_t docid;
+        if (!getU32(p, end, docid)) return false;
+        r.docid = static_cast<int>(docid);
+        if (r.type == IndexWal::OpType::Delete) return p == end;
+        if (r.type == IndexWal::OpType::Marker) return getU64(p, end, r.generation) && p == end;
+        if (r.type != IndexWal::OpType::Add || p == end) return false;
+
+        r.has_meta = *p++ != 0;
+        if (r.has_meta &&
+            !(getStr(p, end, r.title) && getStr(p, end, r.link) &&
+              getStr(p, end, r.summary) && getStr(p, end, r.text))) {
+            return false;
+        }
+        uint32_t n;
+        if (!getU32(p, end, n)) return false;
+        r.tokens.resize(n);
+        for (auto &t : r.tokens) {
+            if (!getStr(p, end, t)) return false;
+        }
+        return p == end;
+    }
+
+    bool writeAll(int fd, const std::string &data) {
+        const char *p = data.data();
+        size_t left = data.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // rename/unlink 需要目录项落盘才算持久
+    void syncDir(const std::string &path) {
+        std::string dir = path.substr(0, path.find_last_of('/') + 1);
+        int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dfd >= 0) {
+            ::fsync(dfd);
+            ::close(dfd);
+        }
+    }
+}
+
+IndexWal::IndexWal(const Options &opts) : opts_(opts) {
+    if (opts_.sync_interval_ms < 1) opts_.sync_interval_ms = 1;
+    if (opts_.sync_batch == 0) opts_.sync_batch = 1;
+}
+
+IndexWal::~IndexWal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    sync_cv_.notify_all();
+    if (sync_thread_.joinable()) sync_thread_.join();
+    durable_cv_.notify_all();
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool IndexWal::open() {
+    fd_ = ::open(opts_.path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open WAL " << opts_.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) == 0) bytes_ = static_cast<uint64_t>(st.st_size);
+    sync_thread_ = std::thread(&IndexWal::syncLoop, this);
+    return true;
+}
+
+size_t IndexWal::replay(const std::function<void(const Record&)> &apply, uint64_t min_generation) {
+    // 上一代（检查点未完成时残留）在前，当前代在后
+    uint64_t gen = 0;
+    size_t count = replayFile(opts_.path + ".prev", apply, min_generation, gen, false);
+    count += replayFile(opts_.path, apply, min_generation, gen, true);
+    generation_ = gen;
+    return count;
+}
+
+size_t IndexWal::replayFile(const std::string &path, const std::function<void(const Record&)> &apply,
+                            uint64_t min_generation, uint64_t &gen, bool truncate) {
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin) return 0;
+    std::string data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+
+    size_t count = 0;
+    size_t records = 0;
+    size_t offset = 0;
+    while (data.size() - offset >= 8) {
+        const char *p = data.data() + offset;
+        const char *end = data.data() + data.size();
+        uint32_t len, crc;
+        getU32(p, end, len);
+        getU32(p, end, crc);
+        if (static_cast<size_t>(end - p) < len || IndexWal::crc32(p, len) != crc) break;
+
+        Record record;
+        if (!decodePayload(p, p + len, record)) break;
+        if (record.type == OpType::Marker) {
+            gen = record.generation;
+        } else if (gen >= min_generation) {
+            // 更早的代已包含在检查点中
+            apply(record);
+            count++;
+        }
+        records++;
+        offset += 8 + len;
+    }
+
+    // 崩溃时写了一半的尾部记录：截断，后续追加从完整记录之后开始
+    if (offset < data.size()) {
+        std::cerr << "WAL " << path << ": discarding " << (data.size() - offset)
+                  << " trailing bytes after " << records << " records" << std::endl;
+        if (truncate && fd_ >= 0 && ftruncate(fd_, static_cast<off_t>(offset)) == 0) {
+            bytes_ = offset;
+        }
+    }
+    return count;
+}
+
+uint64_t IndexWal::append(const Record &record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 日志已失效：不再缓冲，返回的 LSN 永远不会落盘，waitDurable 立即返回 false
+    if (!broken_) {
+        encodeRecord(buffer_, record);
+        appended_++;
+        if (++buffered_records_ >= opts_.sync_batch) sync_cv_.notify_one();
+    }
+    return next_lsn_++;
+}
+
+bool IndexWal::waitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    durable_cv_.wait(lock, [this, lsn]() {
+        return durable_lsn_ >= lsn || failed_ || broken_ || stopping_;
+    });
+    return durable_lsn_ >= lsn;
+}
+
+bool IndexWal::flushLocked() {
+    std::string data;
+    size_t records;
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (broken_) return false;
+        data.swap(buffer_);
+        records = buffered_records_;
+        buffered_records_ = 0;
+        lsn = next_lsn_ - 1;
+    }
+
+    bool ok = true;
+    bool truncated = true;
+    if (!data.empty()) {
+        ok = writeAll(fd_, data) && ::fdatasync(fd_) == 0;
+        syncs_++;
+        if (ok) {
+            bytes_ += data.size();
+        } else {
+            std::cerr << "WAL write failed: " << std::strerror(errno) << std::endl;
+            // 去掉可能写了一半的记录，否则之后追加的记录在重放时会被当作损坏的尾部截掉
+            truncated = ::ftruncate(fd_, static_cast<off_t>(bytes_.load())) == 0;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ok) {
+            durable_lsn_ = lsn;
+            failed_ = false;
+            flush_failures_ = 0;
+        } else if (!truncated || ++flush_failures_ > kFlushRetries) {
+            // 无法恢复到完整记录的边界，或多次重试仍失败：日志永久失效，缓冲中的记录都不会落盘
+            std::cerr << "WAL " << opts_.path << " disabled after write failure, "
+                      << "updates are no longer durable" << std::endl;
+            broken_ = true;
+            buffer_.clear();
+            buffered_records_ = 0;
+        } else {
+            // 未写入的记录放回缓冲前部，由提交线程在下个间隔重试；durable_lsn_ 不前移
+            data += buffer_;
+            buffer_.swap(data);
+            buffered_records_ += records;
+            failed_ = true;
+        }
+    }
+    durable_cv_.notify_all();
+    return ok;
+}
+
+void IndexWal::syncLoop() {
+    const auto interval = std::chrono::milliseconds(opts_.sync_interval_ms);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        sync_cv_.wait_for(lock, interval, [this]() {
+            return stopping_ || buffered_records_ >= opts_.sync_batch;
+        });
+        if (buffer_.empty() || broken_) {
+            if (stopping_) break;
+            continue;
+        }
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> io(io_mutex_);
+            flushLocked();
+        }
+        lock.lock();
+    }
+}
+
+uint64_t IndexWal::rotate() {
+    std::lock_guard<std::mutex> io(io_mutex_);
+    // 先把缓冲落盘，等待中的写入都留在当前代
+    if (!flushLocked()) return 0;
+
+    std::string prev = opts_.path + ".prev";
+    struct stat st;
+    if (::stat(prev.c_str(), &st) == 0) {
+        // 上一次检查点没有完成：当前代并入 path.prev，下一个检查点一并覆盖
+        std::ifstream fin(opts_.path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+        int pfd = ::open(prev.c_str(), O_WRONLY | O_APPEND);
+        bool ok = pfd >= 0 && writeAll(pfd, data) && ::fsync(pfd) == 0;
+        if (pfd >= 0) ::close(pfd);
+        if (!ok) return 0;
+    } else if (std::rename(opts_.path.c_str(), prev.c_str()) != 0) {
+        return 0;
+    }
+
+    // 新一代以 Marker 开头；临时文件 + rename，崩溃时不会留下没有 Marker 的文件
+    uint64_t next = generation_ + 1;
+    Record marker;
+    marker.type = OpType::Marker;
+    marker.generation = next;
+    std::string data;
+    encodeRecord(data, marker);
+
+    std::string tmp = opts_.path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    bool ok = writeAll(fd, data) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmp.c_str(), opts_.path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return 0;  // 后续追加仍写入已改名的文件，重放时同样会读到
+    }
+    syncDir(opts_.path);
+
+    int new_fd = ::open(opts_.path.c_str(), O_WRONLY | O_APPEND);
+    if (new_fd < 0) return 0;
+    ::close(fd_);
+    fd_ = new_fd;
+    bytes_ = data.size();
+    generation_ = next;
+    syncs_++;
+    return next;
+}
+
+void IndexWal::dropPrevious() {
+    std::lock_guard<std::mutex> io(io_mutex_);
+    std::string prev = opts_.path + ".prev";
+    if (::unlink(prev.c_str()) == 0) syncDir(prev);
+}
+
+IndexWal::Stats IndexWal::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {appended_.load(), syncs_.load(), bytes_.load(), durable_lsn_, broken_};
+}
+
+uint32_t IndexWal::crc32(const char *data, size_t len, uint32_t crc) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t c = crc ^ 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        c = table[(c ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
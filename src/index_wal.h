@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// 动态索引预写日志（WAL）
+//
+// - 追加写的二进制文件，每条记录：[u32 长度][u32 CRC32][载荷]
+// - 组提交：append 只写入内存缓冲并返回 LSN，后台线程按间隔或条数批量 write + fdatasync，
+//   waitDurable 等待所在批次落盘；并发写入共享一次 fsync
+// - 写盘失败时截断回上次落盘的位置，未写入的记录放回缓冲重试；连续失败超过 kFlushRetries 次
+//   或无法截断时日志永久失效：之后的 append 被丢弃，waitDurable 返回 false，durable LSN 不再前移
+// - 启动时 replay 在基础索引（及二进制检查点）之上重放；遇到不完整或校验失败的尾部记录时截断
+// - 日志分代：每个文件以 Marker 记录开头，rotate 把当前文件改名为 path.prev 并开始新一代；
+//   检查点写好后 dropPrevious 删除上一代。重放时先读 path.prev 再读 path，
+//   跳过代数小于检查点所含代数的记录（没有 Marker 的旧文件视为第 0 代）
+class IndexWal {
+public:
+    struct Options {
+        std::string path;
+        int sync_interval_ms = 5;   // 组提交最长间隔（毫秒）
+        size_t sync_batch = 256;    // 缓冲达到该条数时立即提交
+    };
+
+    enum class OpType : uint8_t {
+        Add = 1,      // 新增或覆盖文档
+        Delete = 2,   // 删除文档
+        Marker = 3,   // 代的起点（只由 rotate 写入，不交给 replay 的回调）
+    };
+
+    // 保存分词结果而非原文：重放时无需重新分词
+    struct Record {
+        OpType type = OpType::Add;
+        int docid = 0;
+        bool has_meta = false;
+        std::string title;
+        std::string link;
+        std::string summary;
+        std::string text;
+        std::vector<std::string> tokens;
+        uint64_t generation = 0;  // Marker 记录的代数
+    };
+
+    struct Stats {
+        uint64_t appended;       // 追加的记录数
+        uint64_t syncs;          // fsync 次数
+        uint64_t bytes;          // 当前日志文件大小
+        uint64_t durable_lsn;    // 已落盘的最大 LSN
+        bool failed;             // 日志已永久失效
+    };
+
+    explicit IndexWal(const Options &opts);
+    ~IndexWal();
+
+    IndexWal(const IndexWal&) = delete;
+    IndexWal& operator=(const IndexWal&) = delete;
+
+    // 打开（不存在则创建）日志文件并启动提交线程
+    bool open();
+
+    // 顺序重放代数 >= min_generation 的有效记录（上一代文件在前），返回重放条数；
+    // 应在第一次 append 之前调用
+    size_t replay(const std::function<void(const Record&)> &apply, uint64_t min_generation = 0);
+
+    // 追加一条记录，返回其 LSN（尚未落盘）；日志失效后记录被丢弃，该 LSN 不会落盘
+    uint64_t append(const Record &record);
+
+    // 等待 lsn 所在批次落盘；写盘失败（包括稍后重试成功的批次）或日志失效时返回 false
+    bool waitDurable(uint64_t lsn);
+
+    // 开始新一代日志并返回其代数（失败返回 0）；调用方需保证期间没有并发 append。
+    // 只改名、新建文件，不复制数据；上一次的 path.prev 尚未删除（检查点失败）时并入其中
+    uint64_t rotate();
+
+    // 检查点已覆盖上一代后删除 path.prev
+    void dropPrevious();
+
+    // 当前代数（replay 之后有效）
+    uint64_t generation() const { return generation_.load(); }
+
+    const std::string &path() const { return opts_.path; }
+    uint64_t sizeBytes() const { return bytes_.load(); }
+    Stats getStats() const;
+
+    // CRC32（IEEE）；crc 传入上一段的结果即可分段计算（检查点也用它校验正文）
+    static uint32_t crc32(const char *data, size_t len, uint32_t crc = 0);
+
+private:
+    void syncLoop();
+
+    // 把缓冲写入文件并 fdatasync（调用方持有 io_mutex_）；失败时截断并把记录放回缓冲
+    bool flushLocked();
+
+    static constexpr int kFlushRetries = 3;  // 连续失败超过该次数后日志失效
+
+    // 重放一个文件，gen 为读到的最新代数；truncate 为 true 时截断不完整的尾部
+    size_t replayFile(const std::string &path, const std::function<void(const Record&)> &apply,
+                      uint64_t min_generation, uint64_t &gen, bool truncate);
+
+    Options opts_;
+    int fd_ = -1;
+
+    std::mutex io_mutex_;              // 串行化文件写入与重写
+    mutable std::mutex mutex_;         // 保护缓冲与 LSN
+    std::condition_variable sync_cv_;  // 唤醒提交线程
+    std::condition_variable durable_cv_;
+    std::string buffer_;
+    size_t buffered_records_ = 0;
+    uint64_t next_lsn_ = 1;
+    uint64_t durable_lsn_ = 0;
+    bool failed_ = false;      // 最近一次提交失败（成功提交后清除）
+    bool broken_ = false;      // 永久失效
+    int flush_failures_ = 0;   // 连续失败次数
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> appended_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> generation_{0};
+    std::thread sync_thread_;
+};
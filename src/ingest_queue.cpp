@@ -0,0 +1,155 @@
+#include "ingest_queue.h"
+#include "near_dup_filter.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // 一次提交按该条数切分成多个分词任务，大批量提交也能并行分词
+    constexpr size_t kChunkRequests = 64;
+}
+
+IngestQueue::IngestQueue(DynamicInvertedIndex &index, const Options &opts, NearDupFilter *dedup)
+    : index_(index), opts_(opts), dedup_(dedup) {
+    if (opts_.max_batch == 0) opts_.max_batch = 1;
+    pool_ = std::make_unique<ThreadPool>(std::max<size_t>(opts_.threads, 1));
+    writer_ = std::thread(&IngestQueue::writerLoop, this);
+}
+
+IngestQueue::~IngestQueue() {
+    // 线程池析构时执行完剩余的分词任务，之后写线程把队列应用完再退出
+    pool_.reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+}
+
+uint64_t IngestQueue::submit(std::vector<Request> &&requests) {
+    if (requests.empty()) return 0;
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    uint64_t last_seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || pending_ + requests.size() > opts_.max_pending) return 0;
+
+        for (size_t i = 0; i < requests.size(); i += kChunkRequests) {
+            auto chunk = std::make_shared<Chunk>();
+            size_t end = std::min(requests.size(), i + kChunkRequests);
+            chunk->requests.assign(std::make_move_iterator(requests.begin() + i),
+                                   std::make_move_iterator(requests.begin() + end));
+            next_seq_ += chunk->requests.size();
+            chunk->last_seq = next_seq_ - 1;
+            chunks_.push_back(chunk);
+            chunks.push_back(std::move(chunk));
+        }
+        pending_ += requests.size();
+        last_seq = next_seq_ - 1;
+    }
+    requests.clear();
+
+    for (auto &chunk : chunks) {
+        pool_->enqueue([this, chunk]() { tokenize(chunk); });
+    }
+    return last_seq;
+}
+
+void IngestQueue::tokenize(const std::shared_ptr<Chunk> &chunk) {
+    // 分词不持有队列锁与索引锁
+    std::vector<DynamicInvertedIndex::Update> updates(chunk->requests.size());
+    for (size_t i = 0; i < chunk->requests.size(); ++i) {
+        auto &request = chunk->requests[i];
+        auto &update = updates[i];
+        update.docid = request.docid;
+        update.remove = request.remove;
+        if (!request.remove) {
+            JiebaTokenizer::instance().tokenize(request.text, update.tokens);
+            update.meta = std::move(request.meta);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunk->updates = std::move(updates);
+        chunk->requests.clear();
+        chunk->ready = true;
+    }
+    ready_cv_.notify_one();
+}
+
+void IngestQueue::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_cv_.wait(lock, [this]() {
+            return stopping_ || (!chunks_.empty() && chunks_.front()->ready);
+        });
+        if (chunks_.empty() || !chunks_.front()->ready) {
+            if (stopping_) break;
+            continue;
+        }
+
+        // 取出队首连续的已分词请求，凑成一个微批次（至少一段）
+        std::vector<DynamicInvertedIndex::Update> batch;
+        uint64_t last_seq = 0;
+        while (!chunks_.empty() && chunks_.front()->ready &&
+               (batch.empty() || batch.size() + chunks_.front()->updates.size() <= opts_.max_batch)) {
+            auto &updates = chunks_.front()->updates;
+            batch.insert(batch.end(), std::make_move_iterator(updates.begin()),
+                         std::make_move_iterator(updates.end()));
+            last_seq = chunks_.front()->last_seq;
+            chunks_.pop_front();
+        }
+
+        // 过滤只在写线程上进行，按序号顺序与已应用的写入比较
+        size_t count = batch.size();
+        lock.unlock();
+        std::vector<NearDupFilter::Rejection> rejected;
+        if (dedup_) rejected = dedup_->filter(batch);
+        bool durable = index_.applyBatch(batch);
+        lock.lock();
+
+        // 批次内的请求序号连续，第 i 条为 last_seq - count + 1 + i
+        for (const auto &rejection : rejected) {
+            rejections_.emplace(last_seq - count + 1 + rejection.index, rejection.duplicate_of);
+        }
+        while (rejections_.size() > kMaxRejections) rejections_.erase(rejections_.begin());
+
+        applied_seq_ = last_seq;
+        if (durable) {
+            durable_seq_ = last_seq;
+        } else {
+            durable_failures_++;
+        }
+        pending_ -= count;
+        batches_++;
+        applied_cv_.notify_all();
+    }
+}
+
+bool IngestQueue::waitFor(uint64_t seq, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return applied_cv_.wait_for(lock, std::chrono::milliseconds(std::max(timeout_ms, 0)),
+                                [this, seq]() { return applied_seq_ >= seq; });
+}
+
+bool IngestQueue::isDurable(uint64_t seq) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durable_seq_ >= seq;
+}
+
+bool IngestQueue::rejection(uint64_t seq, int &duplicate_of) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rejections_.find(seq);
+    if (it == rejections_.end()) return false;
+    duplicate_of = it->second;
+    return true;
+}
+
+IngestQueue::Stats IngestQueue::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {next_seq_ - 1, applied_seq_, durable_seq_, durable_failures_, pending_, batches_};
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "dynamic_index.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+class ThreadPool;
+class NearDupFilter;
+
+// 动态索引异步写入队列
+//
+// - submit 为每条请求分配递增序号后立即返回；分词在线程池上进行，不持有任何索引锁
+// - 单个写线程按序号顺序取出已分词的请求，攒成微批次调用 applyBatch，
+//   整批只发布一次新版本、共享一次 WAL 落盘
+// - waitFor(seq) 等待该序号之前的写入都已应用（查询可见），用于读己之写
+// - 落盘单独跟踪：durable_seq 之前的写入都已写入 WAL 并落盘（未启用 WAL 时等于 applied_seq）。
+//   某批落盘失败时 durable_seq 停在其前，直到之后的批次落盘（WAL 按顺序提交，后面的落盘即前面的也已落盘）；
+//   需要确认持久化的调用方（如写入源提交偏移量）只应以 durable_seq 为准
+// - 设置了近重复过滤时，写线程在应用每个微批次前按序号顺序过滤：被丢弃的请求同样推进
+//   applied_seq，但按序号记录下来（保留最近 kMaxRejections 条），由 rejection 查询
+class IngestQueue {
+public:
+    struct Options {
+        size_t threads = 2;          // 分词线程数
+        size_t max_batch = 512;      // 单个微批次最多的请求数
+        size_t max_pending = 100000; // 未应用的请求上限，超过时 submit 拒绝
+    };
+
+    // 一条写请求：删除时只需 docid
+    struct Request {
+        int docid = 0;
+        bool remove = false;
+        std::string text;  // 待分词文本
+        std::shared_ptr<const DynamicInvertedIndex::DocumentMeta> meta;  // 可为空
+    };
+
+    struct Stats {
+        uint64_t submitted_seq;  // 已分配的最大序号
+        uint64_t applied_seq;    // 已应用的最大序号
+        uint64_t durable_seq;    // 该序号及之前的写入都已落盘
+        size_t durable_failures; // 落盘失败的微批次数
+        size_t pending;          // 排队中（含分词中）的请求数
+        size_t batches;          // 已应用的微批次数
+    };
+
+    // dedup 可为空；非空时生命周期长于本对象
+    IngestQueue(DynamicInvertedIndex &index, const Options &opts, NearDupFilter *dedup = nullptr);
+    // 停止前应用完已提交的请求
+    ~IngestQueue();
+
+    IngestQueue(const IngestQueue&) = delete;
+    IngestQueue& operator=(const IngestQueue&) = delete;
+
+    // 按顺序提交一组请求，返回最后一条的序号；
+    // 队列已满或为空时返回 0，此时 requests 保持不变，调用方可稍后重试
+    uint64_t submit(std::vector<Request> &&requests);
+
+    // 等待 seq 及之前的请求全部应用（可见），超时返回 false；不代表已落盘，见 isDurable
+    bool waitFor(uint64_t seq, int timeout_ms);
+
+    // seq 及之前的请求是否都已落盘
+    bool isDurable(uint64_t seq) const;
+
+    // seq 对应的请求是否因近重复被丢弃，是则给出重复的已有文档
+    bool rejection(uint64_t seq, int &duplicate_of) const;
+
+    Stats getStats() const;
+
+private:
+    // 一段连续序号的请求，分词完成后 ready 置位
+    struct Chunk {
+        uint64_t last_seq = 0;
+        std::vector<Request> requests;
+        std::vector<DynamicInvertedIndex::Update> updates;
+        bool ready = false;
+    };
+
+    static constexpr size_t kMaxRejections = 100000;
+
+    void tokenize(const std::shared_ptr<Chunk> &chunk);
+    void writerLoop();
+
+    DynamicInvertedIndex &index_;
+    Options opts_;
+    NearDupFilter *dedup_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;    // 唤醒写线程
+    std::condition_variable applied_cv_;  // 唤醒 waitFor
+    std::deque<std::shared_ptr<Chunk>> chunks_;  // 按序号排列
+    uint64_t next_seq_ = 1;
+    uint64_t applied_seq_ = 0;
+    uint64_t durable_seq_ = 0;
+    size_t durable_failures_ = 0;
+    std::map<uint64_t, int> rejections_;  // 序号 -> 重复的已有文档
+    size_t pending_ = 0;
+    size_t batches_ = 0;
+    bool stopping_ = false;
+
+    std::unique_ptr<ThreadPool> pool_;
+    std::thread writer_;
+};
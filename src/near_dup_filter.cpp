@@ -0,0 +1,153 @@
+#include "near_dup_filter.h"
+#include "simhash.h"
+#include <algorithm>
+
+NearDupFilter::NearDupFilter(const DynamicInvertedIndex &index, const Options &opts)
+    : index_(index), opts_(opts) {
+    // 段数 = 阈值 + 1 才能保证不漏检；每段至少 2 位
+    opts_.threshold = std::clamp(opts_.threshold, 0, 31);
+    bands_ = static_cast<size_t>(opts_.threshold) + 1;
+    band_bits_ = static_cast<unsigned>(64 / bands_);
+    tables_.resize(bands_);
+}
+
+void NearDupFilter::load(const WeightedInvertedIndex &base) {
+    // 基础文档没有保存分词结果：由倒排列表反转出每篇文档的词哈希，每个词只算一次
+    std::unordered_map<int, std::vector<uint64_t>> hashes;
+    for (const auto &[term, postings] : base.data()) {
+        uint64_t hash = SimHasher::tokenHash(term);
+        for (const auto &posting : postings) hashes[posting.first].push_back(hash);
+    }
+    for (auto &[docid, list] : hashes) {
+        // 已被删除或更新的基础文档不登记，更新后的版本由下面的动态索引补上
+        if (list.size() < opts_.min_terms || !index_.contains(docid)) continue;
+        insert(docid, SimHasher::simhash64(list));
+    }
+
+    index_.forEachDocTerms([this](int docid, const std::vector<std::string> &terms) {
+        uint64_t sig;
+        if (signature(terms, sig)) {
+            insert(docid, sig);
+        } else {
+            erase(docid);
+        }
+    });
+}
+
+std::vector<NearDupFilter::Rejection> NearDupFilter::filter(std::vector<DynamicInvertedIndex::Update> &batch) {
+    std::vector<DynamicInvertedIndex::Update> out;
+    std::vector<Rejection> rejections;
+    out.reserve(batch.size());
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto &update = batch[i];
+        const int docid = update.docid;
+        uint64_t sig = 0;
+        if (docid < 0) {
+            out.push_back(std::move(update));
+            continue;
+        }
+        if (update.remove || !signature(update.tokens, sig)) {
+            erase(docid);
+            out.push_back(std::move(update));
+            continue;
+        }
+
+        // 已在索引中（或本批中先写入过）的文档是更新，只替换签名
+        bool known = (static_cast<size_t>(docid) < present_.size() && present_[docid]) ||
+                     index_.contains(docid);
+        if (!known) {
+            checked_++;
+            int dup = findDuplicate(sig, docid);
+            if (dup >= 0 && opts_.mode == Mode::Reject) {
+                rejections.push_back({i, dup});
+                rejected_++;
+                continue;
+            }
+            if (dup >= 0) {
+                DynamicInvertedIndex::Update removal;
+                removal.docid = dup;
+                removal.remove = true;
+                out.push_back(std::move(removal));
+                erase(dup);
+                replaced_++;
+            }
+        }
+        insert(docid, sig);
+        out.push_back(std::move(update));
+    }
+    batch = std::move(out);
+    return rejections;
+}
+
+NearDupFilter::Stats NearDupFilter::getStats() const {
+    return {signatures_.load(), checked_.load(), rejected_.load(), replaced_.load()};
+}
+
+uint64_t NearDupFilter::bandKey(uint64_t sig, size_t band) const {
+    // 最后一段取剩余的全部高位
+    unsigned shift = static_cast<unsigned>(band) * band_bits_;
+    unsigned width = band + 1 == bands_ ? 64 - shift : band_bits_;
+    uint64_t mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+    return (sig >> shift) & mask;
+}
+
+void NearDupFilter::insert(int docid, uint64_t sig) {
+    size_t slot = static_cast<size_t>(docid);
+    if (slot < present_.size() && present_[slot]) {
+        if (sigs_[slot] == sig) return;
+        erase(docid);
+    }
+    if (slot >= present_.size()) {
+        present_.resize(slot + 1, false);
+        sigs_.resize(slot + 1, 0);
+    }
+    present_[slot] = true;
+    sigs_[slot] = sig;
+    for (size_t band = 0; band < bands_; ++band) {
+        tables_[band][bandKey(sig, band)].push_back(docid);
+    }
+    signatures_++;
+}
+
+void NearDupFilter::erase(int docid) {
+    size_t slot = static_cast<size_t>(docid);
+    if (slot >= present_.size() || !present_[slot]) return;
+    for (size_t band = 0; band < bands_; ++band) {
+        auto it = tables_[band].find(bandKey(sigs_[slot], band));
+        if (it == tables_[band].end()) continue;
+        auto &bucket = it->second;
+        auto pos = std::find(bucket.begin(), bucket.end(), docid);
+        if (pos != bucket.end()) {
+            *pos = bucket.back();
+            bucket.pop_back();
+        }
+        if (bucket.empty()) tables_[band].erase(it);
+    }
+    present_[slot] = false;
+    signatures_--;
+}
+
+int NearDupFilter::findDuplicate(uint64_t sig, int self) const {
+    for (size_t band = 0; band < bands_; ++band) {
+        auto it = tables_[band].find(bandKey(sig, band));
+        if (it == tables_[band].end()) continue;
+        for (int candidate : it->second) {
+            if (candidate == self) continue;
+            if (SimHasher::hammingDistance(sig, sigs_[candidate]) <= opts_.threshold) return candidate;
+        }
+    }
+    return -1;
+}
+
+bool NearDupFilter::signature(const std::vector<std::string> &tokens, uint64_t &sig) const {
+    // 按去重后的词计算，与基础文档（由倒排还原）和检查点恢复的文档一致
+    std::vector<uint64_t> hashes;
+    hashes.reserve(tokens.size());
+    for (const auto &token : tokens) hashes.push_back(SimHasher::tokenHash(token));
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    if (hashes.size() < opts_.min_terms) return false;
+    sig = SimHasher::simhash64(hashes);
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "dynamic_index.h"
+#include "weighted_inverted_index.h"
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+
+// 写入时的近重复过滤（SimHash + 分段 LSH）
+//
+// - 每个已索引文档保存 64 位 SimHash 签名，按去重后的词计算（与词序、词频无关，
+//   重启时可由基础索引的倒排与动态索引保存的词还原）
+// - 签名切成 threshold + 1 段，每段一张哈希表（段值 -> docid）：汉明距离不超过 threshold 的
+//   两个签名至少有一段完全相同（抽屉原理），每篇新文档只需查 threshold + 1 个桶并比较桶内候选；
+//   阈值越大每段越短、桶越大
+// - 只检查新文档：已在索引中的文档更新时只替换签名
+// - 除 load 外只由写入队列的写线程调用，不加锁；统计可并发读取
+class NearDupFilter {
+public:
+    enum class Mode {
+        Reject,   // 丢弃新文档
+        Replace,  // 删除已有的重复文档，保留新文档
+    };
+
+    struct Options {
+        int threshold = 3;       // 汉明距离不超过该值视为重复（0 为只拒绝完全相同的签名）
+        Mode mode = Mode::Reject;
+        size_t min_terms = 8;    // 去重后的词少于该数的短文档签名区分度低，不参与检测
+    };
+
+    struct Stats {
+        size_t signatures;   // 签名表中的文档数
+        uint64_t checked;    // 检测过的新文档数
+        uint64_t rejected;   // 因重复被丢弃的新文档数
+        uint64_t replaced;   // 被新文档替换（删除）的已有文档数
+    };
+
+    NearDupFilter(const DynamicInvertedIndex &index, const Options &opts);
+
+    NearDupFilter(const NearDupFilter&) = delete;
+    NearDupFilter& operator=(const NearDupFilter&) = delete;
+
+    // 载入已有文档的签名：基础索引中仍存活的文档，再用动态索引中的文档覆盖；
+    // 须在 WAL 重放之后、写入队列启动之前调用
+    void load(const WeightedInvertedIndex &base);
+
+    // 被丢弃的写操作：在原批次中的下标与它重复的已有文档
+    struct Rejection {
+        size_t index;
+        int duplicate_of;
+    };
+
+    // 按顺序过滤一批已分词的写操作（原地修改）：重复的新文档被移除（Reject），
+    // 或在其之前插入删除已有文档的操作（Replace）；同一批中先到的文档也参与比较。
+    // 返回被移除的写操作，供调用方按序号告知提交者
+    std::vector<Rejection> filter(std::vector<DynamicInvertedIndex::Update> &batch);
+
+    Stats getStats() const;
+
+private:
+    // 签名的第 band 段
+    uint64_t bandKey(uint64_t sig, size_t band) const;
+
+    // 登记或替换文档的签名
+    void insert(int docid, uint64_t sig);
+    void erase(int docid);
+
+    // 查找与 sig 重复的已登记文档（排除 self），没有时返回 -1
+    int findDuplicate(uint64_t sig, int self) const;
+
+    // 去重后的词计算签名，词太少时返回 false
+    bool signature(const std::vector<std::string> &tokens, uint64_t &sig) const;
+
+    const DynamicInvertedIndex &index_;
+    Options opts_;
+    size_t bands_;
+    unsigned band_bits_;
+
+    // docid 下标的平坦数组（内部 ID 稠密）
+    std::vector<uint64_t> sigs_;
+    std::vector<bool> present_;
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> tables_;  // 每段：段值 -> docid
+
+    std::atomic<size_t> signatures_{0};
+    std::atomic<uint64_t> checked_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> replaced_{0};
+};
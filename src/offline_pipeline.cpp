@@ -2,6 +2,7 @@
 #include "tokenizer.h"
 #include "simhash.h"
 #include "weighted_inverted_index.h"
+#include "thread_pool.h"
 #include <unordered_map>
 #include <fstream>
 #include <sstream>
@@ -10,6 +11,8 @@
 #include <sys/types.h>
 #include <iostream>
 #include <cctype>
+#include <iterator>
+#include <thread>
 
 static bool ensureDir(const std::string &dir) {
     struct stat st{};
@@ -23,16 +26,34 @@ bool OfflinePipeline::run(const std::vector<std::string> &xml_files, const std::
     if (xml_files.empty()) return false;
     if (!ensureDir(output_dir)) return false;
 
-    // 1) 解析所有 XML，构建网页库
+    // 1) 解析所有 XML，构建网页库：每个文件一个任务并行解析，
+    //    再按输入顺序移动拼接，网页顺序（去重保留哪一篇、输出顺序）与串行解析一致
+    std::vector<std::vector<Page>> parsed(xml_files.size());
+    std::vector<char> parsed_ok(xml_files.size(), 0);
+    {
+        // 线程池析构时等待所有解析任务完成
+        size_t threads = std::min(xml_files.size(), std::max<size_t>(1, std::thread::hardware_concurrency()));
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < xml_files.size(); ++i) {
+            pool.enqueue([&xml_files, &parsed, &parsed_ok, i]() {
+                parsed_ok[i] = PageParser::parseFromXmlFile(xml_files[i], parsed[i]);
+            });
+        }
+    }
+
+    size_t total = 0;
+    for (const auto &one : parsed) total += one.size();
     std::vector<Page> pages;
-    for (const auto &f : xml_files) {
-        std::cout << "Parsing XML file: " << f << std::endl;
-        std::vector<Page> one;
-        if (!PageParser::parseFromXmlFile(f, one)) {
-            std::cout << "Failed to parse XML file: " << f << std::endl;
+    pages.reserve(total);
+    for (size_t i = 0; i < xml_files.size(); ++i) {
+        if (!parsed_ok[i]) {
+            std::cout << "Failed to parse XML file: " << xml_files[i] << std::endl;
             continue;
         }
-        pages.insert(pages.end(), one.begin(), one.end());
+        std::cout << "Parsed XML file: " << xml_files[i] << " (" << parsed[i].size() << " pages)" << std::endl;
+        pages.insert(pages.end(), std::make_move_iterator(parsed[i].begin()),
+                     std::make_move_iterator(parsed[i].end()));
+        std::vector<Page>().swap(parsed[i]);
     }
     if (pages.empty()) return false;
 
@@ -40,7 +61,7 @@ bool OfflinePipeline::run(const std::vector<std::string> &xml_files, const std::
     std::vector<Page> dedup_pages;
     dedup_pages.reserve(pages.size());
     std::vector<uint64_t> signatures; // 已保留的 simhash
-    for (const auto &p : pages) {
+    for (auto &p : pages) {
         std::vector<std::string> toks;
         JiebaTokenizer::instance().tokenize(p.title + "\n" + p.description, toks);
         uint64_t sig = SimHasher::simhash64(toks);
@@ -49,7 +70,7 @@ bool OfflinePipeline::run(const std::vector<std::string> &xml_files, const std::
             if (SimHasher::hammingDistance(sig, ex) <= simhash_threshold) { dup = true; break; }
         }
         if (!dup) {
-            dedup_pages.push_back(p);
+            dedup_pages.push_back(std::move(p));
             signatures.push_back(sig);
         }
     }
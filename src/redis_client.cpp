@@ -0,0 +1,259 @@
+#include "redis_client.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+    inline long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline struct timeval toTimeval(int ms) {
+        struct timeval tv;
+        tv.tv_sec = ms / 1000;
+        tv.tv_usec = (ms % 1000) * 1000;
+        return tv;
+    }
+
+    // 每批 pipeline 发送的最大写请求数
+    constexpr size_t kWriteBatch = 64;
+}
+
+RedisClient::RedisClient(const Options &opts) : opts_(opts) {
+    if (opts_.pool_size == 0) opts_.pool_size = 1;
+    writer_ = std::thread(&RedisClient::writerLoop, this);
+}
+
+RedisClient::~RedisClient() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    for (auto *ctx : idle_) redisFree(ctx);
+    idle_.clear();
+}
+
+redisContext *RedisClient::connect() {
+    redisContext *ctx = redisConnectWithTimeout(opts_.host.c_str(), opts_.port,
+                                                toTimeval(opts_.connect_timeout_ms));
+    if (ctx == nullptr || ctx->err) {
+        if (ctx) {
+            std::cerr << "Redis connection error: " << ctx->errstr << std::endl;
+            redisFree(ctx);
+        } else {
+            std::cerr << "Redis connection error: can't allocate redis context" << std::endl;
+        }
+        return nullptr;
+    }
+    // 之后的每条命令都受此超时约束
+    redisSetTimeout(ctx, toTimeval(opts_.timeout_ms));
+    return ctx;
+}
+
+redisContext *RedisClient::acquire(bool &connect_failed) {
+    connect_failed = false;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_.empty()) {
+            redisContext *ctx = idle_.back();
+            idle_.pop_back();
+            return ctx;
+        }
+        if (created_ >= opts_.pool_size) {
+            // 池已耗尽：不排队，直接放弃
+            return nullptr;
+        }
+        ++created_;
+    }
+
+    // 建连在锁外进行
+    redisContext *ctx = connect();
+    if (!ctx) {
+        connect_failed = true;
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        --created_;
+    }
+    return ctx;
+}
+
+void RedisClient::release(redisContext *ctx, bool ok) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (ok && !ctx->err) {
+        idle_.push_back(ctx);
+    } else {
+        // 出错的连接状态不可信，直接丢弃
+        redisFree(ctx);
+        --created_;
+    }
+}
+
+bool RedisClient::allowRequest(bool &probe) {
+    probe = false;
+    long long until = open_until_ms_.load(std::memory_order_acquire);
+    if (until == 0) return true;
+    if (nowMs() < until) return false;
+    // 半开：CAS 抢探测权，同一时刻只有一个调用访问 Redis
+    bool expected = false;
+    if (!probing_.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) return false;
+    probe = true;
+    return true;
+}
+
+void RedisClient::recordSuccess(bool probe) {
+    consecutive_failures_.store(0, std::memory_order_relaxed);
+    // 只有探测成功才闭合；熔断前发出、此时才返回的调用不算数
+    if (!probe) return;
+    open_until_ms_.store(0, std::memory_order_release);
+    probing_.store(false, std::memory_order_release);
+    std::cerr << "Redis circuit breaker closed" << std::endl;
+}
+
+void RedisClient::recordFailure(bool probe) {
+    errors_++;
+    int failures = consecutive_failures_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (probe || failures >= opts_.breaker_threshold) {
+        // 熔断（探测失败时立即再次熔断）；先更新结束时刻再交还探测权
+        open_until_ms_.store(nowMs() + opts_.breaker_cooldown_ms, std::memory_order_release);
+        consecutive_failures_.store(0, std::memory_order_relaxed);
+        if (probe) probing_.store(false, std::memory_order_release);
+        std::cerr << "Redis circuit breaker open for " << opts_.breaker_cooldown_ms << "ms" << std::endl;
+    }
+}
+
+void RedisClient::abandonProbe(bool probe) {
+    if (probe) probing_.store(false, std::memory_order_release);
+}
+
+bool RedisClient::run(const std::function<bool(redisContext*)> &fn) {
+    bool probe = false;
+    if (!allowRequest(probe)) {
+        rejected_++;
+        return false;
+    }
+    bool connect_failed = false;
+    redisContext *ctx = acquire(connect_failed);
+    if (!ctx) {
+        if (connect_failed) {
+            recordFailure(probe);
+        } else {
+            abandonProbe(probe);
+            rejected_++;
+        }
+        return false;
+    }
+
+    bool ok = fn(ctx);
+    // fn 返回 false 但连接无错误时（如 key 不存在）不计为故障
+    if (ctx->err) {
+        recordFailure(probe);
+    } else {
+        recordSuccess(probe);
+    }
+    release(ctx, !ctx->err);
+    return ok;
+}
+
+bool RedisClient::get(const std::string &key, const std::function<void(std::string_view)> &on_value) {
+    return run([&](redisContext *ctx) {
+        redisReply *reply = (redisReply*)redisCommand(ctx, "GET %b", key.data(), key.size());
+        if (reply == nullptr) return false;
+        bool hit = false;
+        if (reply->type == REDIS_REPLY_STRING) {
+            on_value(std::string_view(reply->str, reply->len));
+            hit = true;
+        }
+        freeReplyObject(reply);
+        return hit;
+    });
+}
+
+void RedisClient::setexAsync(std::string key, int ttl, std::string value) {
+    // 熔断冷却期间直接丢弃；半开时照常入队，由写线程参与探测
+    if (nowMs() < open_until_ms_.load(std::memory_order_relaxed)) {
+        dropped_puts_++;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (queue_.size() >= opts_.async_queue_size) {
+            dropped_puts_++;
+            return;
+        }
+        queue_.push_back({std::move(key), ttl, std::move(value)});
+    }
+    queue_cv_.notify_one();
+}
+
+void RedisClient::writerLoop() {
+    redisContext *ctx = nullptr;
+    std::vector<PendingPut> batch;
+    batch.reserve(kWriteBatch);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) break;
+            while (!queue_.empty() && batch.size() < kWriteBatch) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        bool probe = false;
+        if (!allowRequest(probe)) {
+            dropped_puts_ += batch.size();
+            batch.clear();
+            continue;
+        }
+        if (!ctx) {
+            ctx = connect();
+            if (!ctx) {
+                recordFailure(probe);
+                dropped_puts_ += batch.size();
+                batch.clear();
+                continue;
+            }
+        }
+
+        // pipeline：先全部写出，再依次读取回复
+        for (const auto &p : batch) {
+            redisAppendCommand(ctx, "SETEX %b %d %b",
+                               p.key.data(), p.key.size(), p.ttl,
+                               p.value.data(), p.value.size());
+        }
+        bool ok = true;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            void *reply = nullptr;
+            if (redisGetReply(ctx, &reply) != REDIS_OK) {
+                ok = false;
+                break;
+            }
+            freeReplyObject(reply);
+        }
+        batch.clear();
+
+        if (ok) {
+            recordSuccess(probe);
+        } else {
+            recordFailure(probe);
+            redisFree(ctx);
+            ctx = nullptr;
+        }
+    }
+
+    if (ctx) redisFree(ctx);
+}
+
+RedisClient::Stats RedisClient::getStats() const {
+    return {
+        errors_.load(),
+        rejected_.load(),
+        dropped_puts_.load(),
+        open_until_ms_.load(std::memory_order_relaxed) != 0
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <hiredis/hiredis.h>
+
+// Redis 客户端：连接池 + 每次调用超时 + 熔断 + 异步写
+//
+// - 读请求从连接池取连接，池中无空闲且已达上限时立即放弃（按未命中处理），
+//   不在锁上排队等待
+// - 每条命令受 socket 级超时约束（timeout_ms）
+// - 连续失败 breaker_threshold 次后熔断 breaker_cooldown_ms，期间所有调用直接失败；
+//   冷却结束后（半开）只放行一个探测请求，其余继续拒绝，探测成功才恢复，失败则再次熔断
+// - 写请求进入有界队列，由后台线程批量 pipeline 发送；队列满时丢弃
+class RedisClient {
+public:
+    struct Options {
+        std::string host = "127.0.0.1";
+        int port = 6379;
+        size_t pool_size = 4;              // 读连接池上限
+        int timeout_ms = 50;               // 单条命令超时
+        int connect_timeout_ms = 100;      // 建连超时
+        int breaker_threshold = 5;         // 连续失败多少次后熔断
+        int breaker_cooldown_ms = 5000;    // 熔断持续时间
+        size_t async_queue_size = 1024;    // 异步写队列上限
+    };
+
+    struct Stats {
+        size_t errors;         // 失败的调用（含超时）
+        size_t rejected;       // 熔断或连接池耗尽而直接放弃的调用
+        size_t dropped_puts;   // 异步写队列满而丢弃的写
+        bool breaker_open;     // 当前是否处于熔断状态（含半开）
+    };
+
+    explicit RedisClient(const Options &opts);
+    ~RedisClient();
+
+    RedisClient(const RedisClient&) = delete;
+    RedisClient& operator=(const RedisClient&) = delete;
+
+    // 同步 GET；命中时以 reply 缓冲区的视图调用 on_value（避免拷贝）
+    bool get(const std::string &key, const std::function<void(std::string_view)> &on_value);
+
+    // 异步 SETEX，立即返回
+    void setexAsync(std::string key, int ttl, std::string value);
+
+    // 在池化连接上执行任意同步操作（管理类命令使用）；fn 返回 false 视为失败
+    bool run(const std::function<bool(redisContext*)> &fn);
+
+    Stats getStats() const;
+
+private:
+    struct PendingPut {
+        std::string key;
+        int ttl;
+        std::string value;
+    };
+
+    redisContext *connect();
+    redisContext *acquire(bool &connect_failed);
+    void release(redisContext *ctx, bool ok);
+
+    // 是否放行本次调用；半开时只有抢到探测权的调用放行，probe 置为 true
+    bool allowRequest(bool &probe);
+    void recordSuccess(bool probe);
+    void recordFailure(bool probe);
+    // 放行后未真正访问 Redis（如连接池耗尽）：交还探测权
+    void abandonProbe(bool probe);
+
+    void writerLoop();
+
+    Options opts_;
+
+    // 读连接池
+    std::mutex pool_mutex_;
+    std::vector<redisContext*> idle_;
+    size_t created_ = 0;
+
+    // 熔断状态
+    std::atomic<int> consecutive_failures_{0};
+    std::atomic<long long> open_until_ms_{0};  // 0 表示闭合，否则为熔断结束时刻
+    std::atomic<bool> probing_{false};          // 半开状态下已有探测请求在进行
+
+    // 异步写
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<PendingPut> queue_;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    std::atomic<size_t> errors_{0};
+    std::atomic<size_t> rejected_{0};
+    std::atomic<size_t> dropped_puts_{0};
+};
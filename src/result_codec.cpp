@@ -0,0 +1,228 @@
+#include "result_codec.h"
+#include <cstring>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#ifdef SEARCH_CACHE_LZ4
+#include <lz4.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace {
+    constexpr unsigned char kMagic = 0xB5;
+    constexpr unsigned char kVersion = 3;      // 写入版本
+    constexpr unsigned char kMinVersion = 1;   // 可读取的最低版本
+    constexpr unsigned char kFlagLZ4 = 0x01;
+    constexpr size_t kHeaderSize = 3;
+
+    // 单条结果解码上限，防止损坏数据导致超大分配
+    constexpr uint64_t kMaxCount = 1u << 20;
+
+    inline void putVarint(std::string &out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    inline bool getVarint(std::string_view &in, uint64_t &v) {
+        v = 0;
+        for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+            unsigned char b = static_cast<unsigned char>(in.front());
+            in.remove_prefix(1);
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    inline void putString(std::string &out, const std::string &s) {
+        putVarint(out, s.size());
+        out.append(s);
+    }
+
+    inline bool getString(std::string_view &in, std::string_view &s) {
+        uint64_t len;
+        if (!getVarint(in, len) || len > in.size()) return false;
+        s = in.substr(0, static_cast<size_t>(len));
+        in.remove_prefix(static_cast<size_t>(len));
+        return true;
+    }
+
+    inline uint64_t zigzag(int64_t v) {
+        return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t v) {
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    void encodePayload(const std::vector<SearchResult> &results, std::string &out) {
+        size_t estimate = 8;
+        for (const auto &r : results) {
+            estimate += 24 + r.title.size() + r.link.size() + r.summary.size() + r.key.size();
+        }
+        out.reserve(out.size() + estimate);
+
+        putVarint(out, results.size());
+        for (const auto &r : results) {
+            putVarint(out, zigzag(r.docid));
+            char buf[sizeof(double)];
+            std::memcpy(buf, &r.score, sizeof(double));
+            out.append(buf, sizeof(double));
+            putString(out, r.title);
+            putString(out, r.link);
+            putString(out, r.summary);
+            putString(out, r.key);
+        }
+    }
+
+    bool decodePayload(std::string_view in, unsigned char version,
+                       std::vector<ResultCodec::ResultView> &views) {
+        uint64_t count;
+        if (!getVarint(in, count) || count > kMaxCount) return false;
+        views.clear();
+        views.reserve(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count; ++i) {
+            ResultCodec::ResultView v;
+            uint64_t zz;
+            if (!getVarint(in, zz)) return false;
+            v.docid = static_cast<int>(unzigzag(zz));
+            if (in.size() < sizeof(double)) return false;
+            std::memcpy(&v.score, in.data(), sizeof(double));
+            in.remove_prefix(sizeof(double));
+            if (!getString(in, v.title) || !getString(in, v.link) || !getString(in, v.summary)) {
+                return false;
+            }
+            if (version >= 3 && !getString(in, v.key)) return false;
+            views.push_back(v);
+        }
+        return in.empty();
+    }
+
+    bool decodeLegacyJson(std::string_view data, std::vector<SearchResult> &results) {
+        try {
+            json j = json::parse(data.begin(), data.end());
+            results.clear();
+            for (const auto &item : j) {
+                SearchResult r;
+                r.docid = item["docid"];
+                r.title = item["title"];
+                r.link = item["link"];
+                r.summary = item["summary"];
+                r.score = item["score"];
+                results.push_back(r);
+            }
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+}
+
+bool ResultCodec::isBinary(std::string_view data) {
+    return data.size() >= kHeaderSize && static_cast<unsigned char>(data[0]) == kMagic;
+}
+
+std::string ResultCodec::encode(const std::vector<SearchResult> &results,
+                                bool compress,
+                                size_t compress_min_bytes,
+                                uint64_t stored_at_ms) {
+    std::string out;
+    out.push_back(static_cast<char>(kMagic));
+    out.push_back(static_cast<char>(kVersion));
+    out.push_back(0);
+    putVarint(out, stored_at_ms);
+#ifdef SEARCH_CACHE_LZ4
+    const size_t header_size = out.size();
+#endif
+    encodePayload(results, out);
+
+#ifdef SEARCH_CACHE_LZ4
+    size_t raw_size = out.size() - header_size;
+    if (compress && raw_size >= compress_min_bytes && raw_size <= static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        std::string packed;
+        packed.push_back(static_cast<char>(kMagic));
+        packed.push_back(static_cast<char>(kVersion));
+        packed.push_back(static_cast<char>(kFlagLZ4));
+        putVarint(packed, stored_at_ms);
+        putVarint(packed, raw_size);
+        size_t prefix = packed.size();
+        int bound = LZ4_compressBound(static_cast<int>(raw_size));
+        packed.resize(prefix + static_cast<size_t>(bound));
+        int n = LZ4_compress_default(out.data() + header_size, &packed[prefix],
+                                     static_cast<int>(raw_size), bound);
+        // 压缩后没有变小就保留原始编码
+        if (n > 0 && prefix + static_cast<size_t>(n) < out.size()) {
+            packed.resize(prefix + static_cast<size_t>(n));
+            return packed;
+        }
+    }
+#else
+    (void)compress;
+    (void)compress_min_bytes;
+#endif
+    return out;
+}
+
+bool ResultCodec::decodeViews(std::string_view data,
+                              std::vector<ResultView> &views,
+                              std::string &scratch,
+                              uint64_t *stored_at_ms) {
+    if (!isBinary(data)) return false;
+    unsigned char version = static_cast<unsigned char>(data[1]);
+    unsigned char flags = static_cast<unsigned char>(data[2]);
+    if (version < kMinVersion || version > kVersion) return false;
+
+    std::string_view payload = data.substr(kHeaderSize);
+    uint64_t stored_at = 0;
+    if (version >= 2 && !getVarint(payload, stored_at)) return false;
+    if (stored_at_ms) *stored_at_ms = stored_at;
+
+    if (flags & kFlagLZ4) {
+#ifdef SEARCH_CACHE_LZ4
+        uint64_t raw_size;
+        if (!getVarint(payload, raw_size) || raw_size > static_cast<uint64_t>(LZ4_MAX_INPUT_SIZE)) {
+            return false;
+        }
+        scratch.resize(static_cast<size_t>(raw_size));
+        int n = LZ4_decompress_safe(payload.data(), &scratch[0],
+                                    static_cast<int>(payload.size()),
+                                    static_cast<int>(raw_size));
+        if (n < 0 || static_cast<uint64_t>(n) != raw_size) return false;
+        payload = scratch;
+#else
+        // 未编译 LZ4 支持，视为未命中
+        (void)scratch;
+        return false;
+#endif
+    }
+    return decodePayload(payload, version, views);
+}
+
+bool ResultCodec::decode(std::string_view data, std::vector<SearchResult> &results,
+                         uint64_t *stored_at_ms) {
+    if (!isBinary(data)) {
+        if (stored_at_ms) *stored_at_ms = 0;
+        return decodeLegacyJson(data, results);
+    }
+
+    std::vector<ResultView> views;
+    std::string scratch;
+    if (!decodeViews(data, views, scratch, stored_at_ms)) return false;
+
+    results.clear();
+    results.reserve(views.size());
+    for (const auto &v : views) {
+        SearchResult r;
+        r.docid = v.docid;
+        r.title.assign(v.title.data(), v.title.size());
+        r.link.assign(v.link.data(), v.link.size());
+        r.summary.assign(v.summary.data(), v.summary.size());
+        r.key.assign(v.key.data(), v.key.size());
+        r.score = v.score;
+        results.emplace_back(std::move(r));
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <vector>
+#include "search_engine.h"
+
+// 缓存结果的二进制编解码
+//
+// 格式（小端）：
+//   [magic 0xB5][version][flags][varint 写入时间（毫秒，version>=2）][payload]
+//   flags bit0 = LZ4 压缩，此时 payload = varint(原始长度) + LZ4 数据
+//   原始 payload = varint(count) + count * {
+//       zigzag varint docid, 8 字节 double score,
+//       varint 长度 + title, varint 长度 + link, varint 长度 + summary,
+//       varint 长度 + key（外部文档 ID，version>=3） }
+//
+// 旧版本写入 Redis 的是 JSON 数组（首字节为 '['），解码时仍兼容；
+// JSON 与 version 1 条目没有写入时间，stored_at_ms 解码为 0。
+namespace ResultCodec {
+    // 解码视图：字符串字段直接指向输入缓冲区（或解压缓冲区），不做拷贝
+    struct ResultView {
+        int docid;
+        double score;
+        std::string_view title;
+        std::string_view link;
+        std::string_view summary;
+        std::string_view key;
+    };
+
+    // 编码；compress 为 true 且编译时启用 LZ4 时，
+    // 超过 compress_min_bytes 且确实变小才压缩
+    std::string encode(const std::vector<SearchResult> &results,
+                       bool compress = false,
+                       size_t compress_min_bytes = 512,
+                       uint64_t stored_at_ms = 0);
+
+    // 零拷贝解码。压缩数据会解压到 scratch，视图指向 scratch，
+    // 因此 scratch 和 data 的生命周期都必须覆盖 views 的使用期。
+    // 不支持 JSON 旧格式（返回 false）。
+    bool decodeViews(std::string_view data,
+                     std::vector<ResultView> &views,
+                     std::string &scratch,
+                     uint64_t *stored_at_ms = nullptr);
+
+    // 解码为 SearchResult（二进制格式或旧 JSON 格式）
+    bool decode(std::string_view data, std::vector<SearchResult> &results,
+                uint64_t *stored_at_ms = nullptr);
+
+    // 是否为二进制格式（否则按旧 JSON 处理）
+    bool isBinary(std::string_view data);
+}
@@ -1,258 +1,491 @@
 #include "search_cache.h"
+#include "result_codec.h"
 #include <sstream>
 #include <iostream>
-#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
 
-using json = nlohmann::json;
+namespace {
+    const char *kGenerationKey = "search:gen";
+    const char *kTermGenerationKey = "search:termgen";
+    
+    // 墙钟毫秒：写入时间会随 Redis 条目在进程间传递
+    inline uint64_t nowMs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+}
 
-SearchCache::SearchCache(const std::string &redis_host,
-                         int redis_port,
-                         size_t local_capacity,
-                         int cache_ttl)
-    : redis_ctx_(nullptr),
-      redis_host_(redis_host),
-      redis_port_(redis_port),
-      cache_ttl_(cache_ttl),
-      local_capacity_(local_capacity),
+SearchCache::SearchCache(const CacheOptions &opts)
+    : opts_(opts),
+      generation_(0),
       local_hits_(0),
       redis_hits_(0),
-      misses_(0) {
-    connectRedis();
+      shm_hits_(0),
+      misses_(0),
+      negative_hits_(0),
+      stale_hits_(0) {
+    RedisClient::Options ro;
+    ro.host = opts_.redis_host;
+    ro.port = opts_.redis_port;
+    ro.pool_size = opts_.redis_pool_size;
+    ro.timeout_ms = opts_.redis_timeout_ms;
+    ro.connect_timeout_ms = opts_.redis_connect_timeout_ms;
+    ro.breaker_threshold = opts_.redis_breaker_threshold;
+    ro.breaker_cooldown_ms = opts_.redis_breaker_cooldown_ms;
+    ro.async_queue_size = opts_.redis_async_queue;
+    redis_ = std::make_unique<RedisClient>(ro);
+    
+    if (opts_.shm_enable) {
+        ShmResultCache::Options so;
+        so.name = opts_.shm_name;
+        so.slots = opts_.shm_slots;
+        so.slot_bytes = opts_.shm_slot_bytes;
+        shm_ = std::make_unique<ShmResultCache>(so);
+        if (shm_->ok()) {
+            std::cout << "Shared memory cache attached: " << so.name << " (" << so.slots << " slots)" << std::endl;
+        } else {
+            shm_.reset();
+        }
+    }
+    
+    // 预热一条连接，便于启动时发现配置错误
+    bool reachable = redis_->run([](redisContext *ctx) {
+        redisReply *reply = (redisReply*)redisCommand(ctx, "PING");
+        if (reply == nullptr) return false;
+        freeReplyObject(reply);
+        return true;
+    });
+    if (reachable) {
+        std::cout << "Connected to Redis at " << opts_.redis_host << ":" << opts_.redis_port << std::endl;
+    } else {
+        std::cerr << "Redis not reachable at " << opts_.redis_host << ":" << opts_.redis_port
+                  << ", continuing with local cache only" << std::endl;
+    }
+    
+    loadGenerations();
 }
 
-SearchCache::~SearchCache() {
-    disconnectRedis();
+void SearchCache::loadGenerations() {
+    uint64_t gen = 0;
+    std::unordered_map<std::string, uint64_t> term_gens;
+    bool oversized = false;
+    
+    redis_->run([&](redisContext *ctx) {
+        redisReply *reply = (redisReply*)redisCommand(ctx, "GET %s", kGenerationKey);
+        if (reply == nullptr) return false;
+        if (reply->type == REDIS_REPLY_STRING) {
+            gen = std::strtoull(reply->str, nullptr, 10);
+        }
+        freeReplyObject(reply);
+        
+        // 词代数表已超过上限（例如上限调小）：不整表读入，启动后直接折叠
+        reply = (redisReply*)redisCommand(ctx, "HLEN %s", kTermGenerationKey);
+        if (reply == nullptr) return false;
+        oversized = reply->type == REDIS_REPLY_INTEGER && opts_.max_term_generations > 0 &&
+                    static_cast<size_t>(reply->integer) > opts_.max_term_generations;
+        freeReplyObject(reply);
+        if (oversized) return true;
+        
+        reply = (redisReply*)redisCommand(ctx, "HGETALL %s", kTermGenerationKey);
+        if (reply == nullptr) return false;
+        if (reply->type == REDIS_REPLY_ARRAY) {
+            for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+                term_gens[std::string(reply->element[i]->str, reply->element[i]->len)] =
+                    std::strtoull(reply->element[i + 1]->str, nullptr, 10);
+            }
+        }
+        freeReplyObject(reply);
+        return true;
+    });
+    
+    {
+        std::unique_lock lock(gen_mutex_);
+        generation_ = gen;
+        term_generations_ = std::move(term_gens);
+    }
+    if (oversized) resetTermGenerations();
 }
 
-bool SearchCache::connectRedis() {
-    struct timeval timeout = { 2, 0 };  // 2 秒超时
-    redis_ctx_ = redisConnectWithTimeout(redis_host_.c_str(), redis_port_, timeout);
-    
-    if (redis_ctx_ == nullptr || redis_ctx_->err) {
-        if (redis_ctx_) {
-            std::cerr << "Redis connection error: " << redis_ctx_->errstr << std::endl;
-            redisFree(redis_ctx_);
-            redis_ctx_ = nullptr;
-        } else {
-            std::cerr << "Redis connection error: can't allocate redis context" << std::endl;
+std::string SearchCache::versionedKey(const std::vector<std::string> &terms) const {
+    // 全局代数与词代数在同一把锁内读取：清空词代数时两者一起切换
+    std::shared_lock lock(gen_mutex_);
+    std::string key = "g" + std::to_string(generation_.load()) + ":";
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (i > 0) key.push_back(' ');
+        key += terms[i];
+        auto it = term_generations_.find(terms[i]);
+        if (it != term_generations_.end() && it->second > 0) {
+            key.push_back('#');
+            key += std::to_string(it->second);
         }
-        return false;
     }
+    return key;
+}
+
+void SearchCache::invalidateAll() {
+    long long remote = -1;
+    redis_->run([&](redisContext *ctx) {
+        redisReply *reply = (redisReply*)redisCommand(ctx, "INCR %s", kGenerationKey);
+        if (reply == nullptr) return false;
+        if (reply->type == REDIS_REPLY_INTEGER) remote = reply->integer;
+        freeReplyObject(reply);
+        return true;
+    });
     
-    // 测试连接
-    redisReply *reply = (redisReply*)redisCommand(redis_ctx_, "PING");
-    if (reply == nullptr) {
-        std::cerr << "Redis PING failed" << std::endl;
-        redisFree(redis_ctx_);
-        redis_ctx_ = nullptr;
-        return false;
+    // Redis 不可用时本地递增；可用时与 Redis 对齐（取较大值，保证单调）
+    uint64_t cur = generation_.load();
+    uint64_t next = remote > 0 ? std::max<uint64_t>(static_cast<uint64_t>(remote), cur + 1) : cur + 1;
+    while (!generation_.compare_exchange_weak(cur, next)) {
+        next = std::max(next, cur + 1);
     }
-    freeReplyObject(reply);
+}
+
+void SearchCache::invalidateTerms(const std::vector<std::string> &terms) {
+    if (terms.empty()) return;
     
-    std::cout << "Connected to Redis at " << redis_host_ << ":" << redis_port_ << std::endl;
-    return true;
+    if (opts_.max_term_generations > 0) {
+        size_t added = 0;
+        std::shared_lock lock(gen_mutex_);
+        for (const auto &t : terms) added += term_generations_.count(t) == 0;
+        if (term_generations_.size() + added > opts_.max_term_generations) {
+            lock.unlock();
+            resetTermGenerations();
+            return;
+        }
+    }
+    
+    std::vector<long long> remote(terms.size(), -1);
+    redis_->run([&](redisContext *ctx) {
+        for (const auto &t : terms) {
+            redisAppendCommand(ctx, "HINCRBY %s %b 1", kTermGenerationKey, t.data(), t.size());
+        }
+        for (size_t i = 0; i < terms.size(); ++i) {
+            void *r = nullptr;
+            if (redisGetReply(ctx, &r) != REDIS_OK) return false;
+            redisReply *reply = (redisReply*)r;
+            if (reply->type == REDIS_REPLY_INTEGER) remote[i] = reply->integer;
+            freeReplyObject(reply);
+        }
+        return true;
+    });
+    
+    std::unique_lock lock(gen_mutex_);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        uint64_t &gen = term_generations_[terms[i]];
+        gen = remote[i] > 0 ? std::max<uint64_t>(static_cast<uint64_t>(remote[i]), gen + 1) : gen + 1;
+    }
 }
 
-void SearchCache::disconnectRedis() {
-    if (redis_ctx_) {
-        redisFree(redis_ctx_);
-        redis_ctx_ = nullptr;
+void SearchCache::resetTermGenerations() {
+    long long remote = -1;
+    redis_->run([&](redisContext *ctx) {
+        redisAppendCommand(ctx, "INCR %s", kGenerationKey);
+        redisAppendCommand(ctx, "DEL %s", kTermGenerationKey);
+        for (int i = 0; i < 2; ++i) {
+            void *r = nullptr;
+            if (redisGetReply(ctx, &r) != REDIS_OK) return false;
+            redisReply *reply = (redisReply*)r;
+            if (i == 0 && reply->type == REDIS_REPLY_INTEGER) remote = reply->integer;
+            freeReplyObject(reply);
+        }
+        return true;
+    });
+    
+    std::unique_lock lock(gen_mutex_);
+    uint64_t cur = generation_.load();
+    uint64_t next = remote > 0 ? std::max<uint64_t>(static_cast<uint64_t>(remote), cur + 1) : cur + 1;
+    while (!generation_.compare_exchange_weak(cur, next)) {
+        next = std::max(next, cur + 1);
     }
+    std::unordered_map<std::string, uint64_t>().swap(term_generations_);
 }
 
-bool SearchCache::get(const std::string &query, std::vector<SearchResult> &results) {
+SearchCache::~SearchCache() = default;
+
+CacheLookup SearchCache::get(const std::string &query, ResultSetPtr &results) {
+    uint64_t stored_at = 0;
+    
     // 1. 先查本地 LRU 缓存
-    if (getFromLocal(query, results)) {
+    if (getFromLocal(query, results, stored_at)) {
+        CacheLookup state = classify(*results, stored_at);
         std::lock_guard<std::mutex> lock(mutex_);
         local_hits_++;
-        return true;
+        if (results->results.empty()) negative_hits_++;
+        if (state == CacheLookup::Stale) stale_hits_++;
+        return state;
+    }
+    
+    // 2. 再查共享内存（同主机其他进程写入的结果）
+    std::vector<SearchResult> decoded;
+    if (getFromShm(query, decoded, stored_at)) {
+        results = ResultSet::create(std::move(decoded));
+        uint64_t base = stored_at ? stored_at : nowMs();
+        putToLocal(query, results, stored_at, base + static_cast<uint64_t>(ttlFor(*results)) * 1000);
+        CacheLookup state = classify(*results, stored_at);
+        std::lock_guard<std::mutex> lock(mutex_);
+        shm_hits_++;
+        if (results->results.empty()) negative_hits_++;
+        if (state == CacheLookup::Stale) stale_hits_++;
+        return state;
     }
     
-    // 2. 再查 Redis 缓存
-    if (getFromRedis(query, results)) {
-        // 命中后更新本地 LRU
-        putToLocal(query, results);
+    // 3. 再查 Redis 缓存
+    if (getFromRedis(query, decoded, stored_at)) {
+        // 命中后更新本地 LRU，硬过期时间与 Redis 对齐
+        results = ResultSet::create(std::move(decoded));
+        uint64_t base = stored_at ? stored_at : nowMs();
+        putToLocal(query, results, stored_at, base + static_cast<uint64_t>(ttlFor(*results)) * 1000);
+        CacheLookup state = classify(*results, stored_at);
         std::lock_guard<std::mutex> lock(mutex_);
         redis_hits_++;
-        return true;
+        if (results->results.empty()) negative_hits_++;
+        if (state == CacheLookup::Stale) stale_hits_++;
+        return state;
     }
     
-    // 3. 缓存未命中
+    // 4. 缓存未命中
     {
         std::lock_guard<std::mutex> lock(mutex_);
         misses_++;
     }
-    return false;
+    return CacheLookup::Miss;
 }
 
-void SearchCache::put(const std::string &query, const std::vector<SearchResult> &results) {
+void SearchCache::put(const std::string &query, ResultSetPtr results) {
+    if (!results) return;
+    int ttl = ttlFor(*results);
+    if (ttl <= 0) return;
+    
     // 同时更新本地和 Redis 缓存
-    putToLocal(query, results);
-    putToRedis(query, results);
+    uint64_t now = nowMs();
+    putToRemote(query, results->results, now);
+    putToLocal(query, std::move(results), now, now + static_cast<uint64_t>(ttl) * 1000);
 }
 
-bool SearchCache::getFromLocal(const std::string &key, std::vector<SearchResult> &results) {
+int SearchCache::ttlFor(const ResultSet &results) const {
+    return results.results.empty() ? opts_.negative_ttl : opts_.cache_ttl;
+}
+
+CacheLookup SearchCache::classify(const ResultSet &results, uint64_t stored_at_ms) const {
+    // 零结果条目 TTL 很短，过期即重算，不做后台刷新；写入时间未知的旧条目视为新鲜
+    if (results.results.empty() || opts_.soft_ttl <= 0 || stored_at_ms == 0) {
+        return CacheLookup::Fresh;
+    }
+    uint64_t age = nowMs() - std::min(stored_at_ms, nowMs());
+    return age > static_cast<uint64_t>(opts_.soft_ttl) * 1000 ? CacheLookup::Stale : CacheLookup::Fresh;
+}
+
+size_t SearchCache::nodeBytes(const CacheNode &node) {
+    // 只有超出 SSO 容量的字符串才有堆分配
+    static const size_t kSso = std::string().capacity();
+    auto heap = [](const std::string &str) { return str.capacity() > kSso ? str.capacity() + 1 : 0; };
+    
+    // list 节点 + map 节点（key 副本、迭代器、哈希桶指针）
+    size_t bytes = sizeof(CacheNode) + 2 * sizeof(void*)
+                 + sizeof(std::string) + sizeof(NodeList::iterator) + 3 * sizeof(void*)
+                 + 2 * heap(node.key);
+    bytes += heap(node.packed);
+    if (node.value) {
+        // 结果集与 shared_ptr 控制块合并分配
+        const ResultSet &set = *node.value;
+        bytes += sizeof(ResultSet) + 2 * sizeof(void*);
+        bytes += set.results.capacity() * sizeof(SearchResult);
+        for (const auto &r : set.results) {
+            bytes += heap(r.title) + heap(r.link) + heap(r.summary) + heap(r.key);
+        }
+        bytes += set.json.capacity() * sizeof(std::string);
+        for (const auto &j : set.json) bytes += heap(j);
+    }
+    return bytes;
+}
+
+void SearchCache::eraseLocked(NodeList::iterator it) {
+    NodeList &list = it->cold ? cold_list_ : hot_list_;
+    (it->cold ? cold_bytes_ : hot_bytes_) -= it->bytes;
+    lru_map_.erase(it->key);
+    list.erase(it);
+}
+
+void SearchCache::enforceBudgetLocked() {
+    const size_t budget = opts_.local_max_bytes;
+    
+    // 热段超过预算一半时，把最久未用的热条目编码后降级到冷段
+    if (opts_.compress_cold && budget > 0) {
+        while (hot_bytes_ > budget / 2 && hot_list_.size() > 1) {
+            auto it = std::prev(hot_list_.end());
+            hot_bytes_ -= it->bytes;
+            it->packed = ResultCodec::encode(it->value->results, true, 0);
+            it->packed.shrink_to_fit();
+            it->value.reset();
+            it->cold = true;
+            it->bytes = nodeBytes(*it);
+            cold_bytes_ += it->bytes;
+            cold_list_.splice(cold_list_.begin(), hot_list_, it);
+        }
+    }
+    
+    // 按条目数与字节预算淘汰：先冷段尾部，再热段尾部
+    while (!lru_map_.empty() &&
+           (lru_map_.size() > opts_.local_capacity ||
+            (budget > 0 && hot_bytes_ + cold_bytes_ > budget))) {
+        eraseLocked(std::prev(cold_list_.empty() ? hot_list_.end() : cold_list_.end()));
+    }
+}
+
+bool SearchCache::getFromLocal(const std::string &key, ResultSetPtr &results, uint64_t &stored_at_ms) {
     std::lock_guard<std::mutex> lock(mutex_);
     
     auto it = lru_map_.find(key);
     if (it == lru_map_.end()) {
         return false;
     }
+    auto node = it->second;
+    
+    // 已过硬 TTL，删除
+    if (node->expire_at_ms <= nowMs()) {
+        eraseLocked(node);
+        return false;
+    }
+    
+    stored_at_ms = node->stored_at_ms;
+    if (node->cold) {
+        // 冷条目：解码后提升回热段头部
+        std::vector<SearchResult> decoded;
+        if (!ResultCodec::decode(node->packed, decoded)) {
+            eraseLocked(node);
+            return false;
+        }
+        results = ResultSet::create(std::move(decoded));
+        cold_bytes_ -= node->bytes;
+        node->value = results;
+        std::string().swap(node->packed);
+        node->cold = false;
+        node->bytes = nodeBytes(*node);
+        hot_bytes_ += node->bytes;
+        hot_list_.splice(hot_list_.begin(), cold_list_, node);
+        enforceBudgetLocked();
+        return true;
+    }
     
     // 命中，移到链表头部（最近使用）
-    results = it->second->value;
-    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+    results = node->value;
+    hot_list_.splice(hot_list_.begin(), hot_list_, node);
     return true;
 }
 
-void SearchCache::putToLocal(const std::string &key, const std::vector<SearchResult> &results) {
+void SearchCache::putToLocal(const std::string &key, ResultSetPtr results,
+                             uint64_t stored_at_ms, uint64_t expire_at_ms) {
+    if (opts_.local_capacity == 0) return;
+    
+    CacheNode fresh{key, std::move(results), std::string(), stored_at_ms, expire_at_ms, 0, false};
+    fresh.bytes = nodeBytes(fresh);
+    
     std::lock_guard<std::mutex> lock(mutex_);
     
+    // 已存在，先移除旧节点
     auto it = lru_map_.find(key);
     if (it != lru_map_.end()) {
-        // 已存在，更新并移到头部
-        it->second->value = results;
-        lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
-        return;
+        eraseLocked(it->second);
     }
     
-    // 不存在，检查容量
-    if (lru_list_.size() >= local_capacity_) {
-        // 淘汰最久未使用的（链表尾部）
-        auto last = lru_list_.back();
-        lru_map_.erase(last.key);
-        lru_list_.pop_back();
+    // 单条超过整个预算，不缓存
+    if (opts_.local_max_bytes > 0 && fresh.bytes > opts_.local_max_bytes) {
+        return;
     }
     
-    // 插入到头部
-    lru_list_.push_front({key, results});
-    lru_map_[key] = lru_list_.begin();
+    // 插入到热段头部，再按预算降级/淘汰
+    hot_bytes_ += fresh.bytes;
+    hot_list_.push_front(std::move(fresh));
+    lru_map_[key] = hot_list_.begin();
+    enforceBudgetLocked();
 }
 
-bool SearchCache::getFromRedis(const std::string &key, std::vector<SearchResult> &results) {
-    if (!redis_ctx_) {
-        return false;
-    }
-    
+bool SearchCache::getFromShm(const std::string &key, std::vector<SearchResult> &results, uint64_t &stored_at_ms) {
+    if (!shm_) return false;
+    std::string data;
+    return shm_->get(key, data) && deserializeResults(data, results, stored_at_ms);
+}
+
+bool SearchCache::getFromRedis(const std::string &key, std::vector<SearchResult> &results, uint64_t &stored_at_ms) {
     std::string cache_key = "search:" + key;
-    redisReply *reply = (redisReply*)redisCommand(redis_ctx_, "GET %s", cache_key.c_str());
-    
-    if (reply == nullptr) {
-        // 连接断开，尝试重连
-        disconnectRedis();
-        connectRedis();
-        return false;
-    }
-    
     bool success = false;
-    if (reply->type == REDIS_REPLY_STRING) {
-        std::string data(reply->str, reply->len);
-        success = deserializeResults(data, results);
-    }
-    
-    freeReplyObject(reply);
+    redis_->get(cache_key, [&](std::string_view data) {
+        // 直接在 reply 缓冲区上解码，避免中间拷贝
+        success = deserializeResults(data, results, stored_at_ms);
+        
+        // 回填共享内存，剩余 TTL 与 Redis 对齐
+        if (success && shm_) {
+            uint64_t ttl_ms = static_cast<uint64_t>(results.empty() ? opts_.negative_ttl : opts_.cache_ttl) * 1000;
+            uint64_t now = nowMs();
+            uint64_t base = stored_at_ms ? std::min(stored_at_ms, now) : now;
+            if (base + ttl_ms > now) shm_->put(key, data, base + ttl_ms - now);
+        }
+    });
     return success;
 }
 
-void SearchCache::putToRedis(const std::string &key, const std::vector<SearchResult> &results) {
-    if (!redis_ctx_) {
-        return;
-    }
-    
-    std::string cache_key = "search:" + key;
-    std::string data = serializeResults(results);
+void SearchCache::putToRemote(const std::string &key, const std::vector<SearchResult> &results, uint64_t stored_at_ms) {
+    std::string data = serializeResults(results, stored_at_ms);
     
     // 序列化失败，跳过缓存
     if (data.empty()) {
         return;
     }
     
-    redisReply *reply = (redisReply*)redisCommand(redis_ctx_, 
-                                                   "SETEX %s %d %b",
-                                                   cache_key.c_str(),
-                                                   cache_ttl_,
-                                                   data.c_str(),
-                                                   data.size());
-    
-    if (reply == nullptr) {
-        // 连接断开，尝试重连
-        disconnectRedis();
-        connectRedis();
-        return;
+    int ttl = results.empty() ? opts_.negative_ttl : opts_.cache_ttl;
+    
+    // 共享内存同步写入（纯内存拷贝，写冲突时直接放弃）
+    if (shm_) {
+        shm_->put(key, data, static_cast<uint64_t>(ttl) * 1000);
     }
     
-    freeReplyObject(reply);
+    // 异步写入，Redis 延迟不计入请求耗时
+    redis_->setexAsync("search:" + key, ttl, std::move(data));
 }
 
-std::string SearchCache::serializeResults(const std::vector<SearchResult> &results) {
-    // 数据已在 SearchEngine 层清理，直接序列化
-    // 使用 try-catch 作为最后防线
-    try {
-        json j = json::array();
-        
-        for (const auto &r : results) {
-            json item;
-            item["docid"] = r.docid;
-            item["title"] = r.title;
-            item["link"] = r.link;
-            item["summary"] = r.summary;
-            item["score"] = r.score;
-            j.push_back(item);
-        }
-        
-        return j.dump();
-    } catch (const std::exception &e) {
-        // JSON 序列化失败，返回空（不缓存该结果）
-        std::cerr << "JSON serialization error: " << e.what() << std::endl;
-        return "";
-    }
+std::string SearchCache::serializeResults(const std::vector<SearchResult> &results, uint64_t stored_at_ms) {
+    // 二进制编码，可选 LZ4 压缩（见 result_codec.h）
+    return ResultCodec::encode(results, opts_.compress, 512, stored_at_ms);
 }
 
-bool SearchCache::deserializeResults(const std::string &data, std::vector<SearchResult> &results) {
-    try {
-        json j = json::parse(data);
-        results.clear();
-        
-        for (const auto &item : j) {
-            SearchResult r;
-            r.docid = item["docid"];
-            r.title = item["title"];
-            r.link = item["link"];
-            r.summary = item["summary"];
-            r.score = item["score"];
-            results.push_back(r);
-        }
-        
-        return true;
-    } catch (...) {
-        return false;
-    }
+bool SearchCache::deserializeResults(std::string_view data, std::vector<SearchResult> &results, uint64_t &stored_at_ms) {
+    // 兼容旧版本写入的 JSON 条目
+    return ResultCodec::decode(data, results, &stored_at_ms);
 }
 
 SearchCache::Stats SearchCache::getStats() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return {
-        local_hits_,
-        redis_hits_,
-        misses_,
-        lru_list_.size()
-    };
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.local_hits = local_hits_;
+        stats.redis_hits = redis_hits_;
+        stats.shm_hits = shm_hits_;
+        stats.misses = misses_;
+        stats.local_size = lru_map_.size();
+        stats.local_bytes = hot_bytes_ + cold_bytes_;
+        stats.local_cold = cold_list_.size();
+        stats.negative_hits = negative_hits_;
+        stats.stale_hits = stale_hits_;
+    }
+    
+    auto rs = redis_->getStats();
+    stats.redis_errors = rs.errors;
+    stats.redis_rejected = rs.rejected;
+    stats.redis_dropped_puts = rs.dropped_puts;
+    stats.redis_breaker_open = rs.breaker_open;
+    return stats;
 }
 
 void SearchCache::clear() {
+    // 旧代数的 Redis 条目不再可达，由 TTL 过期，避免 KEYS 扫描阻塞 Redis
+    invalidateAll();
+    if (shm_) shm_->clear();
+    
     std::lock_guard<std::mutex> lock(mutex_);
-    lru_list_.clear();
+    hot_list_.clear();
+    cold_list_.clear();
     lru_map_.clear();
-    
-    if (redis_ctx_) {
-        // 清空 Redis 中的搜索缓存（通过模式删除）
-        redisReply *reply = (redisReply*)redisCommand(redis_ctx_, "KEYS search:*");
-        if (reply && reply->type == REDIS_REPLY_ARRAY) {
-            for (size_t i = 0; i < reply->elements; i++) {
-                redisCommand(redis_ctx_, "DEL %s", reply->element[i]->str);
-            }
-        }
-        if (reply) freeReplyObject(reply);
-    }
+    hot_bytes_ = cold_bytes_ = 0;
 }
-
@@ -4,70 +4,112 @@
 #include <list>
 #include <unordered_map>
 #include <mutex>
-#include <hiredis/hiredis.h>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
 #include "search_engine.h"
+#include "cache_types.h"
+#include "redis_client.h"
+#include "shm_cache.h"
 
-// 双层缓存：本地 LRU + Redis
+// 多层缓存：本地 LRU -> 共享内存（可选，同主机进程共享）-> Redis
 class SearchCache {
 public:
-    SearchCache(const std::string &redis_host = "127.0.0.1",
-                int redis_port = 6379,
-                size_t local_capacity = 1000,
-                int cache_ttl = 3600);
+    explicit SearchCache(const CacheOptions &opts);
     ~SearchCache();
     
-    // 查询缓存，返回是否命中
-    bool get(const std::string &query, std::vector<SearchResult> &results);
+    // 查询缓存：未命中 / 新鲜命中 / 过期命中（仍返回结果，调用方负责刷新）
+    // 本地命中只复制共享指针
+    CacheLookup get(const std::string &query, ResultSetPtr &results);
     
-    // 更新缓存
-    void put(const std::string &query, const std::vector<SearchResult> &results);
+    // 更新缓存（Redis 写入异步进行，不阻塞调用方）；空结果按 negative_ttl 缓存
+    void put(const std::string &query, ResultSetPtr results);
     
     // 统计信息
-    struct Stats {
-        size_t local_hits;
-        size_t redis_hits;
-        size_t misses;
-        size_t local_size;
-    };
+    using Stats = CacheStats;
     Stats getStats() const;
     
-    // 清空缓存
+    // 生成带版本的缓存 key（terms 须已排序去重）
+    // 格式：g<全局代数>:term1 term2#<词代数> ...，词代数为 0 时省略
+    std::string versionedKey(const std::vector<std::string> &terms) const;
+    
+    // 使全部缓存失效：全局代数 +1，旧 key 不再被访问，由 TTL 自然过期
+    void invalidateAll();
+    
+    // 只使包含这些词的查询失效：对应词代数 +1；
+    // 词代数表将超过 max_term_generations 时改为全局失效并清空词代数
+    void invalidateTerms(const std::vector<std::string> &terms);
+    
+    // 清空缓存（全局代数 +1 并清空本地 LRU，不再扫描 Redis）
     void clear();
     
 private:
-    // 本地 LRU 缓存节点
+    // 全局代数 +1 并清空词代数（本地与 Redis）：旧 key 都带旧的全局代数，词代数可以从 0 重新开始
+    void resetTermGenerations();
+
+    // 本地 LRU 缓存节点；冷节点只保存编码后的 packed，value 为空
     struct CacheNode {
         std::string key;
-        std::vector<SearchResult> value;
+        ResultSetPtr value;
+        std::string packed;
+        uint64_t stored_at_ms;   // 写入时间（用于软 TTL）
+        uint64_t expire_at_ms;   // 硬过期时间
+        size_t bytes;            // 本节点占用字节（含 key、map 开销）
+        bool cold;               // 位于 cold_list_
     };
+    using NodeList = std::list<CacheNode>;
+    
+    CacheOptions opts_;
     
-    // Redis 连接
-    redisContext *redis_ctx_;
-    std::string redis_host_;
-    int redis_port_;
-    int cache_ttl_;  // Redis 缓存 TTL（秒）
+    // Redis 连接池（连接失败时为熔断状态，调用直接返回未命中）
+    std::unique_ptr<RedisClient> redis_;
     
-    // 本地 LRU 缓存
-    size_t local_capacity_;
-    std::list<CacheNode> lru_list_;
-    std::unordered_map<std::string, std::list<CacheNode>::iterator> lru_map_;
+    // 共享内存层（未启用或映射失败时为空）
+    std::unique_ptr<ShmResultCache> shm_;
+    
+    // 缓存代数：写入索引时递增，嵌入 key 实现 O(1) 失效
+    // 代数保存在 Redis（search:gen / search:termgen），重启后继续递增，不会复用旧 key
+    std::atomic<uint64_t> generation_;
+    std::unordered_map<std::string, uint64_t> term_generations_;
+    mutable std::shared_mutex gen_mutex_;
+    
+    // 本地分段 LRU：新写入/命中的条目在 hot_list_ 头部；
+    // 启用 compress_cold 时热段超过预算一半，尾部降级到 cold_list_ 并编码保存。
+    // 淘汰先从 cold_list_ 尾部开始。两段 list 之间 splice 不会使迭代器失效
+    NodeList hot_list_;
+    NodeList cold_list_;
+    std::unordered_map<std::string, NodeList::iterator> lru_map_;
+    size_t hot_bytes_ = 0;
+    size_t cold_bytes_ = 0;
     mutable std::mutex mutex_;
     
     // 统计
     mutable size_t local_hits_;
     mutable size_t redis_hits_;
+    mutable size_t shm_hits_;
     mutable size_t misses_;
+    mutable size_t negative_hits_;
+    mutable size_t stale_hits_;
     
     // 内部方法
-    bool connectRedis();
-    void disconnectRedis();
-    bool getFromLocal(const std::string &key, std::vector<SearchResult> &results);
-    void putToLocal(const std::string &key, const std::vector<SearchResult> &results);
-    bool getFromRedis(const std::string &key, std::vector<SearchResult> &results);
-    void putToRedis(const std::string &key, const std::vector<SearchResult> &results);
-    
-    // 序列化/反序列化
-    std::string serializeResults(const std::vector<SearchResult> &results);
-    bool deserializeResults(const std::string &data, std::vector<SearchResult> &results);
+    void loadGenerations();
+    bool getFromLocal(const std::string &key, ResultSetPtr &results, uint64_t &stored_at_ms);
+    void putToLocal(const std::string &key, ResultSetPtr results,
+                    uint64_t stored_at_ms, uint64_t expire_at_ms);
+    bool getFromShm(const std::string &key, std::vector<SearchResult> &results, uint64_t &stored_at_ms);
+    bool getFromRedis(const std::string &key, std::vector<SearchResult> &results, uint64_t &stored_at_ms);
+    void putToRemote(const std::string &key, const std::vector<SearchResult> &results, uint64_t stored_at_ms);
+    
+    // 本地分段 LRU 维护（调用方持有 mutex_）
+    static size_t nodeBytes(const CacheNode &node);
+    void eraseLocked(NodeList::iterator it);
+    void enforceBudgetLocked();
+    
+    // 按写入时间判断新鲜度
+    CacheLookup classify(const ResultSet &results, uint64_t stored_at_ms) const;
+    int ttlFor(const ResultSet &results) const;
+    
+    // 序列化/反序列化（二进制格式，兼容旧 JSON 条目）
+    std::string serializeResults(const std::vector<SearchResult> &results, uint64_t stored_at_ms);
+    bool deserializeResults(std::string_view data, std::vector<SearchResult> &results, uint64_t &stored_at_ms);
 };
-
@@ -1,9 +1,11 @@
 #include "search_engine.h"
 #include "search_cache.h"
+#include "thread_pool.h"
 #include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <chrono>
+#include <nlohmann/json.hpp>
 
 namespace {
     // 快速清理非法 UTF-8（只处理一次，避免重复检查）
@@ -45,12 +47,48 @@ namespace {
     }
 }
 
+std::shared_ptr<const ResultSet> ResultSet::create(std::vector<SearchResult> results) {
+    auto set = std::make_shared<ResultSet>();
+    set->json.reserve(results.size());
+    for (const auto &r : results) {
+        set->json.push_back(serialize(r, SearchEngine::FieldAll));
+    }
+    set->results = std::move(results);
+    return set;
+}
+
+std::string ResultSet::serialize(const SearchResult &r, unsigned fields) {
+    nlohmann::json item;
+    // 外部 ID 为整数时保持原来的数字类型
+    long long numeric;
+    size_t used = 0;
+    if (r.key.empty()) {
+        item["docid"] = r.docid;
+    } else {
+        try { numeric = std::stoll(r.key, &used); } catch (...) { used = 0; }
+        if (used == r.key.size() && std::to_string(numeric) == r.key) {
+            item["docid"] = numeric;
+        } else {
+            item["docid"] = r.key;
+        }
+    }
+    item["score"] = r.score;
+    if (fields & SearchEngine::FieldTitle) item["title"] = r.title;
+    if (fields & SearchEngine::FieldLink) item["link"] = r.link;
+    if (fields & SearchEngine::FieldSummary) item["summary"] = r.summary;
+    return item.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
 SearchEngine::SearchEngine(const WeightedInvertedIndex &idx,
                            const std::string &pages,
                            const std::string &offsets)
-    : index(idx), pages_path(pages), offsets_path(offsets), cache_(nullptr) {}
+    : index(idx), pages_path(pages), offsets_path(offsets), cache_(nullptr), cache_depth_(100),
+      coalesce_wait_ms_(200) {}
 
-SearchEngine::~SearchEngine() = default;
+SearchEngine::~SearchEngine() {
+    // 先等待后台刷新结束，再析构缓存
+    refresh_pool_.reset();
+}
 
 bool SearchEngine::loadOffsets() {
     std::ifstream fin(offsets_path);
@@ -134,11 +172,13 @@ std::string SearchEngine::escapeJson(const std::string &s) {
     return out;
 }
 
-void SearchEngine::enableCache(const std::string &redis_host,
-                               int redis_port,
-                               size_t local_capacity,
-                               int cache_ttl) {
-    cache_ = std::make_unique<SearchCache>(redis_host, redis_port, local_capacity, cache_ttl);
+void SearchEngine::enableCache(const CacheOptions &opts) {
+    refresh_pool_.reset();
+    cache_depth_ = std::max<size_t>(opts.max_depth, 1);
+    cache_ = std::make_unique<SearchCache>(opts);
+    if (opts.soft_ttl > 0) {
+        refresh_pool_ = std::make_unique<ThreadPool>(std::max<size_t>(opts.refresh_threads, 1));
+    }
 }
 
 void SearchEngine::getCacheStats(size_t &local_hits, size_t &redis_hits, size_t &misses, size_t &local_size) {
@@ -153,99 +193,300 @@ void SearchEngine::getCacheStats(size_t &local_hits, size_t &redis_hits, size_t
     }
 }
 
+CacheStats SearchEngine::cacheStats() const {
+    CacheStats stats = cache_ ? cache_->getStats() : CacheStats();
+    stats.coalesce_leaders = coalesce_leaders_.load();
+    stats.coalesced = coalesced_.load();
+    stats.coalesce_timeouts = coalesce_timeouts_.load();
+    stats.refreshes = refreshes_.load();
+    return stats;
+}
+
+void SearchEngine::setCoalesceWait(int wait_ms) {
+    coalesce_wait_ms_ = wait_ms;
+}
+
 void SearchEngine::clearCache() {
     if (cache_) {
         cache_->clear();
     }
 }
 
-std::string SearchEngine::makeCacheKey(const std::vector<std::string> &terms, size_t top_k) {
-    std::ostringstream oss;
+void SearchEngine::invalidateCache() {
+    if (cache_) {
+        cache_->invalidateAll();
+    }
+}
+
+void SearchEngine::invalidateCacheTerms(const std::vector<std::string> &terms) {
+    if (cache_) {
+        cache_->invalidateTerms(terms);
+    }
+}
+
+std::vector<std::string> SearchEngine::canonicalTerms(const std::vector<std::string> &terms) {
+    // AND 语义与词序无关：排序去重后 "经济 中国" 与 "中国 经济" 等价
+    std::vector<std::string> out(terms);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+std::string SearchEngine::makeCacheKey(const std::vector<std::string> &terms) {
+    // terms 须已规范化；key 不含 top_k，不同 top_k 共享同一条缓存
+    std::string key;
     for (size_t i = 0; i < terms.size(); ++i) {
-        if (i > 0) oss << " ";
-        oss << terms[i];
+        if (i > 0) key.push_back(' ');
+        key += terms[i];
     }
-    oss << "|" << top_k;
-    return oss.str();
+    return key;
 }
 
-std::vector<SearchResult> SearchEngine::queryRanked(const std::vector<std::string> &terms, size_t top_k) {
+std::string SearchEngine::cacheKey(const std::vector<std::string> &terms) const {
+    return cache_ ? cache_->versionedKey(terms) : makeCacheKey(terms);
+}
+
+void SearchEngine::setRanker(Ranker ranker) {
+    ranker_ = std::move(ranker);
+}
+
+void SearchEngine::setDocResolver(DocResolver resolver) {
+    resolver_ = std::move(resolver);
+}
+
+void SearchEngine::setKeyResolver(KeyResolver resolver) {
+    key_resolver_ = std::move(resolver);
+}
+
+std::vector<std::pair<int, double>> SearchEngine::rank(const std::vector<std::string> &terms,
+                                                       size_t depth) const {
+    auto ranked = ranker_ ? ranker_(terms, depth) : index.searchANDCosineRanked(terms);
+    if (depth && ranked.size() > depth) ranked.resize(depth);
+    return ranked;
+}
+
+std::vector<SearchResult> SearchEngine::materialize(const std::vector<std::pair<int, double>> &ranked,
+                                                    const std::vector<std::string> &terms,
+                                                    unsigned fields) {
     std::vector<SearchResult> results;
+    results.reserve(ranked.size());
+    for (const auto &pr : ranked) {
+        SearchResult r;
+        r.docid = pr.first;
+        r.score = pr.second;
+        if (resolver_ && resolver_(pr.first, r)) {
+            r.title = (fields & FieldTitle) ? cleanUtf8Fast(r.title) : std::string();
+            r.link = (fields & FieldLink) ? cleanUtf8Fast(r.link) : std::string();
+            r.summary = (fields & FieldSummary) ? cleanUtf8Fast(r.summary) : std::string();
+        } else if (!(fields & FieldAll)) {
+            // 只要 docid 与得分：不读网页，但与完整结果一样跳过网页库中没有的文档
+            if (!hasPage(pr.first)) continue;
+        } else {
+            RawPage pg;
+            if (!readPageByDocId(pr.first, pg)) continue;
+            if (fields & FieldTitle) r.title = cleanUtf8Fast(pg.title);
+            if (fields & FieldLink) r.link = cleanUtf8Fast(pg.link);
+            if (fields & FieldSummary) r.summary = cleanUtf8Fast(makeSummary(pg.description, terms));
+        }
+        if (key_resolver_) {
+            r.key = key_resolver_(pr.first);
+            if (r.key == std::to_string(pr.first)) r.key.clear();
+        }
+        results.emplace_back(std::move(r));
+    }
+    return results;
+}
+
+std::vector<SearchResult> SearchEngine::computeRanked(const std::vector<std::string> &terms, size_t depth) {
+    return materialize(rank(terms, depth), terms);
+}
+
+std::vector<SearchResult> SearchEngine::queryRankedFields(const std::vector<std::string> &raw_terms,
+                                                          size_t top_k, unsigned fields) {
+    const std::vector<std::string> terms = canonicalTerms(raw_terms);
+
+    // 已缓存的完整结果足够深时直接截取，无需任何物化
+    if (cache_) {
+        const std::string cache_key = cacheKey(terms);
+        ResultSetPtr cached;
+        CacheLookup state = cache_->get(cache_key, cached);
+        if (state != CacheLookup::Miss &&
+            (cached->results.size() < cache_depth_ || (top_k != 0 && top_k <= cached->results.size()))) {
+            if (state == CacheLookup::Stale) scheduleRefresh(cache_key, terms);
+            size_t n = top_k ? std::min(top_k, cached->results.size()) : cached->results.size();
+            return std::vector<SearchResult>(cached->results.begin(), cached->results.begin() + n);
+        }
+    }
+
+    // 排序阶段只取到 top_k，物化阶段只处理最终返回的结果与请求的字段
+    return materialize(rank(terms, top_k), terms, fields);
+}
+
+void SearchEngine::scheduleRefresh(const std::string &cache_key, const std::vector<std::string> &terms) {
+    if (!refresh_pool_) return;
+    {
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        if (!refreshing_.insert(cache_key).second) return;  // 已在刷新
+    }
+    refreshes_++;
+    refresh_pool_->enqueue([this, cache_key, terms]() {
+        try {
+            cache_->put(cache_key, ResultSet::create(computeRanked(terms, cache_depth_)));
+        } catch (const std::exception &e) {
+            std::cerr << "[CACHE REFRESH] failed: " << e.what() << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        refreshing_.erase(cache_key);
+    });
+}
+
+std::vector<SearchResult> SearchEngine::queryRanked(const std::vector<std::string> &terms, size_t top_k) {
+    ResultSetPtr set = queryRankedShared(terms, top_k);
+    size_t n = top_k ? std::min(top_k, set->results.size()) : set->results.size();
+    return std::vector<SearchResult>(set->results.begin(), set->results.begin() + n);
+}
+
+ResultSetPtr SearchEngine::queryRankedShared(const std::vector<std::string> &raw_terms, size_t top_k) {
+    ResultSetPtr results;
     auto start_time = std::chrono::steady_clock::now();
     
     // 构建查询字符串用于日志
     std::string query_str;
-    for (size_t i = 0; i < terms.size(); ++i) {
+    for (size_t i = 0; i < raw_terms.size(); ++i) {
         if (i > 0) query_str += " ";
-        query_str += terms[i];
+        query_str += raw_terms[i];
     }
     
+    const std::vector<std::string> terms = canonicalTerms(raw_terms);
+    
+    // 缓存按 cache_depth_ 深度存一份结果，较小的 top_k 由调用方截取；
+    // 结果数少于 cache_depth_ 说明已是完整结果，任意 top_k 都可满足
+    auto coversTopK = [this, top_k](const ResultSet &cached) {
+        if (cached.results.size() < cache_depth_) return true;
+        return top_k != 0 && top_k <= cached.results.size();
+    };
+    auto shown = [top_k](const ResultSetPtr &set) {
+        return top_k ? std::min(top_k, set->results.size()) : set->results.size();
+    };
+    
+    // 带代数的 key：索引写入后旧 key 自动失效
+    const std::string cache_key = cacheKey(terms);
+    
     // 如果启用了缓存，先查缓存
-    if (cache_) {
-        std::string cache_key = makeCacheKey(terms, top_k);
-        
+    if (cache_) {        
         // 记录缓存查询前的统计
-        size_t local_hits_before, redis_hits_before, misses_before, local_size;
-        getCacheStats(local_hits_before, redis_hits_before, misses_before, local_size);
+        CacheStats before = cache_->getStats();
         
-        if (cache_->get(cache_key, results)) {
+        CacheLookup state = cache_->get(cache_key, results);
+        if (state != CacheLookup::Miss && coversTopK(*results)) {
+            // 过期命中：先返回旧结果，后台重算（stale-while-revalidate）
+            if (state == CacheLookup::Stale) scheduleRefresh(cache_key, terms);
+            
             auto end_time = std::chrono::steady_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
             
-            // 判断是本地缓存还是 Redis 缓存命中
-            size_t local_hits_after, redis_hits_after, misses_after, _;
-            getCacheStats(local_hits_after, redis_hits_after, misses_after, _);
-            
-            if (local_hits_after > local_hits_before) {
-                std::cout << "[CACHE HIT - LOCAL] Query: \"" << query_str 
-                          << "\" | Results: " << results.size() 
-                          << " | Time: " << duration << "μs" << std::endl;
-            } else {
-                std::cout << "[CACHE HIT - REDIS] Query: \"" << query_str 
-                          << "\" | Results: " << results.size() 
-                          << " | Time: " << duration << "μs" << std::endl;
-            }
+            // 判断命中的是哪一层缓存
+            CacheStats after = cache_->getStats();
+            const char *tier = after.local_hits > before.local_hits ? "LOCAL"
+                             : after.shm_hits > before.shm_hits ? "SHM" : "REDIS";
+            const char *stale = state == CacheLookup::Stale ? " (STALE)" : "";
+            std::cout << "[CACHE HIT - " << tier << stale << "] Query: \"" << query_str 
+                      << "\" | Results: " << shown(results) 
+                      << " | Time: " << duration << "μs" << std::endl;
             return results;
         }
+        results.reset();
         
         std::cout << "[CACHE MISS] Query: \"" << query_str 
                   << "\" | Searching..." << std::endl;
     }
     
-    // 缓存未命中或未启用缓存，执行实际搜索
-    auto ranked = index.searchANDCosineRanked(terms);
-    if (ranked.empty()) {
-        auto end_time = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        std::cout << "[SEARCH] Query: \"" << query_str 
-                  << "\" | Results: 0 | Time: " << duration << "ms" << std::endl;
-        return results;
+    // 启用缓存时按缓存深度取结果，供后续不同 top_k 复用
+    size_t depth = top_k;
+    if (cache_ && depth != 0) depth = std::max(depth, cache_depth_);
+    
+    // 合并并发的相同查询：同一规范化 key 只有一个请求真正执行搜索
+    const std::string &flight_key = cache_key;
+    std::shared_ptr<Flight> flight;
+    bool leader = false;
+    if (coalesce_wait_ms_ > 0) {
+        std::lock_guard<std::mutex> lock(flights_mutex_);
+        auto it = flights_.find(flight_key);
+        if (it == flights_.end()) {
+            flight = std::make_shared<Flight>();
+            flight->depth = depth;
+            flights_.emplace(flight_key, flight);
+            leader = true;
+        } else {
+            flight = it->second;
+        }
     }
     
-    if (top_k && ranked.size() > top_k) ranked.resize(top_k);
-
-    for (const auto &pr : ranked) {
-        RawPage pg;
-        if (!readPageByDocId(pr.first, pg)) continue;
-        SearchResult r;
-        r.docid = pr.first;
-        r.title = cleanUtf8Fast(pg.title);
-        r.link = cleanUtf8Fast(pg.link);
-        r.summary = cleanUtf8Fast(makeSummary(pg.description, terms));
-        r.score = pr.second;
-        results.emplace_back(std::move(r));
+    if (flight && !leader) {
+        // 跟随者：有界等待领头请求的结果，超时或深度不足时自行计算
+        {
+            std::unique_lock<std::mutex> lock(flight->mutex);
+            if (flight->cv.wait_for(lock, std::chrono::milliseconds(coalesce_wait_ms_),
+                                    [&flight]() { return flight->done; })) {
+                bool covers = flight->ok && (flight->depth == 0 ||
+                              flight->results->results.size() < flight->depth ||
+                              (top_k != 0 && top_k <= flight->results->results.size()));
+                if (covers) results = flight->results;
+            } else {
+                coalesce_timeouts_++;
+            }
+        }
+        if (results) {
+            coalesced_++;
+            auto end_time = std::chrono::steady_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+            std::cout << "[COALESCED] Query: \"" << query_str 
+                      << "\" | Results: " << shown(results) 
+                      << " | Time: " << duration << "ms" << std::endl;
+            return results;
+        }
+    } else if (leader) {
+        coalesce_leaders_++;
     }
     
+    // 领头请求：发布结果并唤醒等待者，随后移出 flights_。
+    // 守卫保证任何路径（包括之后的缓存写入、输出抛出异常）都会发布，未发布时以 ok=false 结束
+    struct FlightGuard {
+        SearchEngine &engine;
+        const std::string &key;
+        std::shared_ptr<Flight> flight;
+        bool published = false;
+
+        void publish(bool ok, const ResultSetPtr &results) {
+            if (!flight || published) return;
+            published = true;
+            {
+                std::lock_guard<std::mutex> lock(flight->mutex);
+                if (ok) flight->results = results;
+                flight->ok = ok;
+                flight->done = true;
+            }
+            flight->cv.notify_all();
+            std::lock_guard<std::mutex> lock(engine.flights_mutex_);
+            engine.flights_.erase(key);
+        }
+
+        ~FlightGuard() { publish(false, nullptr); }
+    } flight_guard{*this, flight_key, leader ? flight : nullptr};
+    
+    // 缓存未命中或未启用缓存，执行实际搜索；结果算出即发布，跟随者不必等缓存写入
+    results = ResultSet::create(computeRanked(terms, depth));
+    flight_guard.publish(true, results);
+    
     auto end_time = std::chrono::steady_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
     
     std::cout << "[SEARCH] Query: \"" << query_str 
-              << "\" | Results: " << results.size() 
+              << "\" | Results: " << shown(results) 
               << " | Time: " << duration << "ms";
     
-    // 将结果存入缓存
-    if (cache_ && !results.empty()) {
-        std::string cache_key = makeCacheKey(terms, top_k);
+    // 将结果存入缓存（零结果按 negative_ttl 短期缓存）
+    if (cache_) {
         cache_->put(cache_key, results);
         std::cout << " | Cached: Yes";
     }
@@ -253,5 +494,3 @@ std::vector<SearchResult> SearchEngine::queryRanked(const std::vector<std::strin
     
     return results;
 }
-
-
@@ -4,7 +4,13 @@
 #include <unordered_map>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_set>
+#include <functional>
 #include "weighted_inverted_index.h"
+#include "cache_types.h"
 
 struct SearchResult {
     int docid;
@@ -12,9 +18,24 @@ struct SearchResult {
     std::string link;
     std::string summary; // 根据查询词自动抽取
     double score;        // 余弦相似度
+    std::string key;     // 外部文档 ID，为空表示与 docid 相同
 };
 
+// 不可变结果集：缓存与请求之间按引用计数共享，命中时只复制指针
+// json 为每条结果预先序列化好的 JSON 对象，与 results 一一对应
+struct ResultSet {
+    std::vector<SearchResult> results;
+    std::vector<std::string> json;
+
+    static std::shared_ptr<const ResultSet> create(std::vector<SearchResult> results);
+
+    // 单条结果的 JSON：docid 取外部 ID（整数 key 输出为数字），只输出 fields 中的字段
+    static std::string serialize(const SearchResult &result, unsigned fields);
+};
+using ResultSetPtr = std::shared_ptr<const ResultSet>;
+
 class SearchCache;
+class ThreadPool;
 
 class SearchEngine {
 public:
@@ -26,19 +47,67 @@ public:
     bool loadOffsets();
     
     // 启用缓存
-    void enableCache(const std::string &redis_host = "127.0.0.1",
-                     int redis_port = 6379,
-                     size_t local_capacity = 1000,
-                     int cache_ttl = 3600);
+    void enableCache(const CacheOptions &opts = CacheOptions());
     
     // 获取缓存统计
     void getCacheStats(size_t &local_hits, size_t &redis_hits, size_t &misses, size_t &local_size);
+    CacheStats cacheStats() const;
     
     // 清空缓存
     void clearCache();
+    
+    // 索引变更后的缓存失效：全部失效 / 只失效包含这些词的查询（均为 O(1) 代数递增）
+    void invalidateCache();
+    void invalidateCacheTerms(const std::vector<std::string> &terms);
+    
+    // 并发相同查询合并：跟随者最多等待 wait_ms 毫秒，0 表示关闭合并
+    void setCoalesceWait(int wait_ms);
+
+    // 排序器：返回按得分降序的 (docid, 得分)，depth 为需要的条数（0 不限）；
+    // 未设置时直接查询基础索引。须在开始服务前设置
+    using Ranker = std::function<std::vector<std::pair<int, double>>(
+        const std::vector<std::string> &terms, size_t depth)>;
+    void setRanker(Ranker ranker);
+
+    // 文档解析：返回 true 表示已填好 title/link/summary（如动态写入的文档），
+    // 否则从网页库读取。须在开始服务前设置
+    using DocResolver = std::function<bool(int docid, SearchResult &result)>;
+    void setDocResolver(DocResolver resolver);
+
+    // 内部 ID -> 外部 ID；未设置或返回空串时外部 ID 即 docid。须在开始服务前设置
+    using KeyResolver = std::function<std::string(int docid)>;
+    void setKeyResolver(KeyResolver resolver);
+
+    // 网页库中是否有该文档
+    bool hasPage(int docid) const { return docid_to_offset.count(docid) > 0; }
+
+    // 结果字段（docid 与 score 总是返回），按位组合
+    enum ResultField : unsigned {
+        FieldTitle = 1u << 0,
+        FieldLink = 1u << 1,
+        FieldSummary = 1u << 2,
+        FieldAll = FieldTitle | FieldLink | FieldSummary,
+    };
+
+    // 两阶段检索：先只取 (docid, 得分)，选定最终结果后再读取网页、生成摘要；
+    // 未请求的字段留空，全部未请求时不读网页库
+    std::vector<std::pair<int, double>> rank(const std::vector<std::string> &terms, size_t depth) const;
+    std::vector<SearchResult> materialize(const std::vector<std::pair<int, double>> &ranked,
+                                          const std::vector<std::string> &terms,
+                                          unsigned fields = FieldAll);
+
+    // 只返回部分字段的查询：缓存中已有足够深的完整结果时直接截取，
+    // 否则只排序到 top_k 并按字段物化（不写缓存，不影响完整结果的缓存）
+    std::vector<SearchResult> queryRankedFields(const std::vector<std::string> &terms,
+                                                size_t top_k, unsigned fields);
 
     // 基于 AND + 余弦相似度的查询，返回按得分降序的结果
+    // 查询词会先排序去重（AND 语义下与词序无关）
     std::vector<SearchResult> queryRanked(const std::vector<std::string> &terms, size_t top_k = 20);
+    
+    // 同 queryRanked，但直接返回共享的结果集（不拷贝）；
+    // 结果数可能多于 top_k（缓存深度），调用方只取前 top_k 条
+    ResultSetPtr queryRankedShared(const std::vector<std::string> &terms, size_t top_k = 20);
 
 private:
     struct RawPage { std::string title, link, description; };
@@ -52,12 +121,50 @@ private:
     std::string pages_path;
     std::string offsets_path;
     std::unordered_map<int, std::streampos> docid_to_offset;
+    Ranker ranker_;
+    DocResolver resolver_;
+    KeyResolver key_resolver_;
     
     // 双层缓存
     std::unique_ptr<SearchCache> cache_;
+    size_t cache_depth_;  // 缓存结果的深度，top_k 不超过它的查询共享同一条缓存
+    
+    // 正在执行的查询（single-flight），跟随者等待领头请求的结果
+    struct Flight {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        bool ok = false;
+        size_t depth = 0;
+        ResultSetPtr results;
+    };
+    std::mutex flights_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    int coalesce_wait_ms_;
+    std::atomic<size_t> coalesce_leaders_{0};
+    std::atomic<size_t> coalesced_{0};
+    std::atomic<size_t> coalesce_timeouts_{0};
+    
+    // 执行搜索并读取网页生成结果（不经过缓存）
+    std::vector<SearchResult> computeRanked(const std::vector<std::string> &terms, size_t depth);
+    
+    // 过期命中时在后台重算并回填缓存（同一 key 同时只刷新一次）
+    void scheduleRefresh(const std::string &cache_key, const std::vector<std::string> &terms);
+    std::mutex refresh_mutex_;
+    std::unordered_set<std::string> refreshing_;
+    std::atomic<size_t> refreshes_{0};
+    
+    // 查询词规范化（排序 + 去重）
+    static std::vector<std::string> canonicalTerms(const std::vector<std::string> &terms);
+    
+    // 生成缓存 key（terms 须已规范化）
+    static std::string makeCacheKey(const std::vector<std::string> &terms);
+    
+    // 启用缓存时为带代数的 key，否则同 makeCacheKey
+    std::string cacheKey(const std::vector<std::string> &terms) const;
     
-    // 生成缓存 key
-    std::string makeCacheKey(const std::vector<std::string> &terms, size_t top_k);
+    // 后台刷新线程池；放在最后声明，析构时最先停止，任务不会访问已析构的成员
+    std::unique_ptr<ThreadPool> refresh_pool_;
 };
 
 
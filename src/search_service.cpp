@@ -8,8 +8,15 @@
 #include "weighted_inverted_index.h"
 #include "dynamic_index.h"
 #include "tokenizer.h"
+#include "cache_warmer.h"
+#include "index_wal.h"
+#include "ingest_queue.h"
+#include "feed_tailer.h"
+#include "doc_id_map.h"
+#include "near_dup_filter.h"
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 
 using namespace wfrest;
 using json = nlohmann::json;
@@ -18,6 +25,13 @@ using json = nlohmann::json;
 static HttpServer *g_server = nullptr;
 static SearchEngine *g_engine = nullptr;
 static DynamicInvertedIndex *g_dynamic_index = nullptr;
+static IndexWal *g_wal = nullptr;
+static IngestQueue *g_ingest = nullptr;
+static FeedTailer *g_feed = nullptr;
+static DocIdMap *g_doc_ids = nullptr;
+static NearDupFilter *g_dedup = nullptr;
+static QueryLog *g_query_log = nullptr;
+static CacheWarmer *g_warmer = nullptr;
 
 // 清理无效 UTF-8 字符
 std::string cleanUtf8(const std::string &str) {
@@ -46,6 +60,49 @@ std::string cleanUtf8(const std::string &str) {
     return result;
 }
 
+// 提交写请求到写入队列：成功返回 202 与序号，队列已满返回 429；
+// 202 只表示已入队，近重复过滤等结果在应用后由 /index/status/<seq> 查询
+void submitIngest(std::vector<IngestQueue::Request> requests, HttpResp *resp, json &response) {
+    size_t count = requests.size();
+    uint64_t seq = g_ingest->submit(std::move(requests));
+    if (seq == 0) {
+        resp->set_status(HttpStatusTooManyRequests);
+        response["success"] = false;
+        response["error"] = "Ingest queue is full, retry later";
+        return;
+    }
+    resp->set_status(HttpStatusAccepted);
+    response["success"] = true;
+    response["message"] = "Accepted for indexing";
+    response["seq"] = seq;
+    // 每条请求一个序号，批量提交时为 first_seq..seq（按请求顺序），可逐条查询 /index/status/<seq>
+    if (count > 1) response["first_seq"] = seq - count + 1;
+}
+
+// 外部文档 ID：整数或字符串（如文件 MD5），统一为字符串 key
+bool parseDocKey(const json &value, std::string &key) {
+    if (value.is_number_integer()) {
+        key = value.dump();
+        return true;
+    }
+    if (value.is_string()) {
+        key = value.get<std::string>();
+        return !key.empty();
+    }
+    return false;
+}
+
+// 从请求体构造文档元数据（未提供 title/link 时返回空，保留已有元数据）
+std::shared_ptr<const DynamicInvertedIndex::DocumentMeta> parseDocumentMeta(const json &doc) {
+    if (!doc.contains("title") && !doc.contains("link")) return nullptr;
+    auto meta = std::make_shared<DynamicInvertedIndex::DocumentMeta>();
+    meta->title = doc.value("title", "");
+    meta->link = doc.value("link", "");
+    meta->summary = doc.value("summary", "");
+    meta->text = doc["text"];
+    return meta;
+}
+
 void signalHandler(int signal) {
     std::cout << "\nReceived signal " << signal << ", shutting down search service...\n";
     if (g_server) {
@@ -89,13 +146,15 @@ int main(int argc, char **argv) {
     std::string offsets_path = (fs::path(config.index_dir) / "offsets.bin").string();
     
     size_t total_docs = 0;
+    uint32_t base_limit = 0;
     std::ifstream fin(offsets_path);
     if (fin) {
         int id;
         long long off;
         while (fin >> id >> off) {
-            (void)id; (void)off;
+            (void)off;
             ++total_docs;
+            if (id >= 0) base_limit = std::max(base_limit, static_cast<uint32_t>(id) + 1);
         }
     }
     
@@ -104,13 +163,34 @@ int main(int argc, char **argv) {
         index.loadFromFile(index_path, total_docs);
         g_engine = new SearchEngine(index, pages_path, offsets_path);
         g_engine->loadOffsets();
+        g_engine->setCoalesceWait(config.coalesce_wait_ms);
         
         // 启用缓存
         if (config.enable_cache) {
-            g_engine->enableCache(config.redis_host, 
-                                 config.redis_port, 
-                                 config.cache_capacity, 
-                                 config.cache_ttl);
+            CacheOptions cache_opts;
+            cache_opts.redis_host = config.redis_host;
+            cache_opts.redis_port = config.redis_port;
+            cache_opts.redis_pool_size = config.redis_pool_size;
+            cache_opts.redis_timeout_ms = config.redis_timeout_ms;
+            cache_opts.redis_connect_timeout_ms = config.redis_connect_timeout_ms;
+            cache_opts.redis_breaker_threshold = config.redis_breaker_threshold;
+            cache_opts.redis_breaker_cooldown_ms = config.redis_breaker_cooldown_ms;
+            cache_opts.redis_async_queue = config.redis_async_queue;
+            cache_opts.local_capacity = config.cache_capacity;
+            cache_opts.local_max_bytes = config.cache_max_mb * 1024 * 1024;
+            cache_opts.compress_cold = config.cache_compress_cold;
+            cache_opts.cache_ttl = config.cache_ttl;
+            cache_opts.shm_enable = config.shm_cache_enable;
+            cache_opts.shm_name = config.shm_cache_name;
+            cache_opts.shm_slots = config.shm_cache_slots;
+            cache_opts.shm_slot_bytes = config.shm_cache_slot_bytes;
+            cache_opts.max_depth = config.cache_max_depth;
+            cache_opts.compress = config.cache_compress;
+            cache_opts.negative_ttl = config.cache_negative_ttl;
+            cache_opts.max_term_generations = config.cache_max_term_generations;
+            cache_opts.soft_ttl = config.cache_soft_ttl;
+            cache_opts.refresh_threads = config.cache_refresh_threads;
+            g_engine->enableCache(cache_opts);
             std::cout << "✓ Cache enabled: Redis=" << config.redis_host 
                       << ":" << config.redis_port << "\n";
         }
@@ -118,13 +198,134 @@ int main(int argc, char **argv) {
         std::cout << "✓ Search index loaded: " << total_docs << " documents\n";
         
         // 初始化动态索引（支持实时更新）
-        g_dynamic_index = new DynamicInvertedIndex();
-        if (g_dynamic_index->loadFromFile(index_path, total_docs)) {
-            std::cout << "✓ Dynamic index initialized (supports real-time updates)\n\n";
-        } else {
-            std::cout << "⚠ Dynamic index initialization failed, updates disabled\n\n";
-            delete g_dynamic_index;
-            g_dynamic_index = nullptr;
+        DynamicInvertedIndex::Options dyn_opts;
+        dyn_opts.merge_factor = config.dynamic_merge_factor;
+        dyn_opts.merge_rate_limit = config.dynamic_merge_rate;
+        dyn_opts.merge_cpu_percent = config.dynamic_merge_cpu_percent;
+        dyn_opts.store_text = config.dynamic_store_text;
+        dyn_opts.compress_docs = config.dynamic_compress_docs;
+        dyn_opts.partitions = config.dynamic_partitions;
+        dyn_opts.wal_checkpoint_bytes = static_cast<uint64_t>(config.wal_checkpoint_mb) * 1024 * 1024;
+        g_dynamic_index = new DynamicInvertedIndex(dyn_opts);
+        g_dynamic_index->attachBase(index);
+
+        // 外部 ID -> 稠密内部 ID；基础文档的 docid 原样沿用，须在重放 WAL 之前加载
+        g_doc_ids = new DocIdMap();
+        std::string docid_map_path = config.docid_map_path.empty()
+            ? (fs::path(config.index_dir) / "docid_map.txt").string()
+            : config.docid_map_path;
+        if (!g_doc_ids->open(docid_map_path, base_limit)) {
+            std::cout << "⚠ Docid map unavailable, string docids will not survive restart\n";
+            g_doc_ids->open("", base_limit);
+        }
+        g_engine->setKeyResolver([](int docid) {
+            return docid < 0 ? std::string() : g_doc_ids->key(static_cast<uint32_t>(docid));
+        });
+        
+        // 在基础索引之上重放 WAL，恢复上次运行的增删改
+        if (config.wal_enable) {
+            IndexWal::Options wal_opts;
+            wal_opts.path = config.wal_path.empty()
+                ? (fs::path(config.index_dir) / "dynamic_index.wal").string()
+                : config.wal_path;
+            wal_opts.sync_interval_ms = config.wal_sync_interval_ms;
+            wal_opts.sync_batch = config.wal_sync_batch;
+            g_wal = new IndexWal(wal_opts);
+            if (g_wal->open()) {
+                auto start = std::chrono::steady_clock::now();
+                size_t replayed = g_dynamic_index->attachWal(g_wal);
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                auto stats = g_dynamic_index->getStats();
+                if (stats.checkpoint_bytes > 0) {
+                    std::cout << "✓ Checkpoint loaded: " << stats.checkpoint_bytes << " bytes\n";
+                }
+                std::cout << "✓ WAL replayed: " << replayed << " records from " << wal_opts.path
+                          << " (" << ms << " ms)\n";
+            } else {
+                std::cout << "⚠ WAL unavailable, dynamic updates will not survive restart\n";
+                delete g_wal;
+                g_wal = nullptr;
+            }
+        }
+
+        // 查询统一走基础 + 增量覆盖：一次打分、一份缓存，被删除或更新的基础文档不会重复出现
+        g_engine->setRanker([](const std::vector<std::string> &terms, size_t depth) {
+            return g_dynamic_index->searchANDCosineRanked(terms, depth);
+        });
+        g_engine->setDocResolver([](int docid, SearchResult &result) {
+            DynamicInvertedIndex::DocumentMeta meta;
+            bool has_meta = g_dynamic_index->getDocumentMeta(docid, meta);
+            // 没有元数据但网页库中有（只更新了正文的基础文档）时沿用网页库内容
+            if (!has_meta && g_engine->hasPage(docid)) return false;
+            std::string key = g_doc_ids->key(static_cast<uint32_t>(docid));
+            result.title = meta.title.empty() ? "[动态索引] Doc " + key : meta.title;
+            result.summary = meta.summary.empty() ? "通过API动态添加的文档" : meta.summary;
+            result.link = meta.link.empty() ? "#/doc/" + key : meta.link;
+            return true;
+        });
+
+        // 索引写入后递增缓存代数，避免返回过期结果
+        bool term_scoped = config.cache_term_invalidation;
+        g_dynamic_index->setChangeListener(
+            [term_scoped](const std::vector<std::string> &terms, bool all) {
+                if (all || !term_scoped) {
+                    g_engine->invalidateCache();
+                } else {
+                    g_engine->invalidateCacheTerms(terms);
+                }
+            });
+
+        // 写入时近重复过滤：签名表须包含 WAL 重放后的全部存活文档
+        if (config.ingest_dedup) {
+            NearDupFilter::Options dedup_opts;
+            dedup_opts.threshold = config.ingest_dedup_threshold;
+            dedup_opts.mode = config.ingest_dedup_mode == "replace"
+                ? NearDupFilter::Mode::Replace : NearDupFilter::Mode::Reject;
+            g_dedup = new NearDupFilter(*g_dynamic_index, dedup_opts);
+            auto start = std::chrono::steady_clock::now();
+            g_dedup->load(index);
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            std::cout << "✓ Near-duplicate filter loaded: " << g_dedup->getStats().signatures
+                      << " signatures (" << ms << " ms)\n";
+        }
+
+        IngestQueue::Options ingest_opts;
+        ingest_opts.threads = config.ingest_threads;
+        ingest_opts.max_batch = config.ingest_batch_max;
+        ingest_opts.max_pending = config.ingest_queue_max;
+        g_ingest = new IngestQueue(*g_dynamic_index, ingest_opts, g_dedup);
+        
+        // 追加写 JSONL 写入源：从上次已应用的位置继续读取
+        if (!config.feed_path.empty()) {
+            FeedTailer::Options feed_opts;
+            feed_opts.path = config.feed_path;
+            feed_opts.offset_path = config.feed_offset_path;
+            feed_opts.poll_interval_ms = config.feed_poll_ms;
+            feed_opts.batch_size = std::min(config.feed_batch, config.ingest_queue_max);
+            g_feed = new FeedTailer(*g_ingest, *g_doc_ids, feed_opts);
+            g_feed->start();
+            std::cout << "✓ Feed ingestion enabled: " << config.feed_path << "\n";
+        }
+        std::cout << "✓ Dynamic index initialized (supports real-time updates)\n\n";
+        
+        // 查询日志与启动预热：重放上次运行最热的查询，填充本地缓存；
+        // 在 WAL 重放之后进行，预热结果已包含动态写入
+        g_query_log = new QueryLog(std::max<size_t>(config.warmup_top_n * 4, 1000));
+        if (config.query_log_path.empty()) {
+            config.query_log_path = (fs::path(config.index_dir) / "query_log.txt").string();
+        }
+        g_query_log->load(config.query_log_path);
+        if (config.enable_cache && config.warmup_enable) {
+            CacheWarmer::Options warm_opts;
+            warm_opts.threads = config.warmup_threads;
+            warm_opts.time_limit_ms = config.warmup_time_limit_ms;
+            warm_opts.top_k = static_cast<size_t>(config.default_topk * 2);
+            g_warmer = new CacheWarmer(*g_engine, warm_opts);
+            auto queries = g_query_log->top(config.warmup_top_n);
+            std::cout << "✓ Cache warm-up started: " << queries.size() << " queries\n";
+            g_warmer->start(std::move(queries));
         }
     } else {
         std::cerr << "✗ Error: Search index not found or empty\n";
@@ -142,6 +343,17 @@ int main(int argc, char **argv) {
     // 健康检查端点
     server.GET("/health", [](const HttpReq *req, HttpResp *resp) {
         resp->headers["Content-Type"] = "application/json";
+        // 预热未完成时返回 503，负载均衡暂不转发流量
+        if (g_warmer && !g_warmer->ready()) {
+            json response;
+            response["status"] = "warming";
+            response["service"] = "search";
+            response["warmed"] = g_warmer->warmed();
+            response["total"] = g_warmer->total();
+            resp->set_status(HttpStatusServiceUnavailable);
+            resp->String(response.dump());
+            return;
+        }
         resp->String("{\"status\":\"ok\",\"service\":\"search\"}");
     });
     
@@ -171,9 +383,30 @@ int main(int argc, char **argv) {
             return;
         }
         
+        // 读己之写：等待该序号之前提交的写入可见，超时则返回当前结果并标记 stale
+        std::string wait_seq = req->query("wait_for_seq");
+        if (!wait_seq.empty() && g_ingest) {
+            try {
+                uint64_t seq = std::stoull(wait_seq);
+                if (!g_ingest->waitFor(seq, config.ingest_wait_timeout_ms)) {
+                    response["stale"] = true;
+                } else if (!g_ingest->isDurable(seq)) {
+                    // 已可见但 WAL 落盘失败，重启后可能丢失
+                    response["durable"] = false;
+                }
+                int duplicate_of = -1;
+                if (g_ingest->rejection(seq, duplicate_of)) {
+                    // 该写入因与已有文档近重复被丢弃
+                    response["rejected"] = true;
+                    response["duplicate_of"] = g_doc_ids->key(static_cast<uint32_t>(duplicate_of));
+                }
+            } catch (...) {}
+        }
+        
         // 分词
         std::vector<std::string> terms;
         JiebaTokenizer::instance().tokenize(query, terms);
+        if (g_query_log) g_query_log->record(terms);
         
         if (terms.empty()) {
             response["query"] = query;
@@ -182,70 +415,60 @@ int main(int argc, char **argv) {
             return;
         }
         
-        // 执行搜索：合并静态索引和动态索引的结果
-        std::vector<SearchResult> all_results;
-        
-        // 1. 查询静态索引（SearchEngine）
-        if (g_engine) {
-            auto static_results = g_engine->queryRanked(terms, static_cast<size_t>(topK * 2));
-            all_results = static_results;
-        }
-        
-        // 2. 查询动态索引（DynamicInvertedIndex）
-        if (g_dynamic_index) {
-            auto dynamic_results = g_dynamic_index->searchANDCosineRanked(terms);
-            
-            // 合并动态索引的结果（转换为SearchResult格式）
-            for (const auto &[docid, score] : dynamic_results) {
-                SearchResult sr;
-                sr.docid = docid;
-                sr.score = score;
-                
-                // 尝试获取文档元数据
-                DynamicInvertedIndex::DocumentMeta meta;
-                if (g_dynamic_index->getDocumentMeta(docid, meta)) {
-                    sr.title = meta.title.empty() ? "[动态索引] Doc " + std::to_string(docid) : meta.title;
-                    sr.summary = meta.summary.empty() ? "通过API动态添加的文档" : meta.summary;
-                    sr.link = meta.link.empty() ? "#/doc/" + std::to_string(docid) : meta.link;
-                } else {
-                    sr.title = "[动态索引] Doc " + std::to_string(docid);
-                    sr.summary = "通过API动态添加的文档";
-                    sr.link = "#/doc/" + std::to_string(docid);
-                }
-                
-                all_results.push_back(sr);
+        // 返回字段：fields=title,link,summary 的任意组合（docid 与 score 总是返回），缺省为全部
+        unsigned fields = SearchEngine::FieldAll;
+        std::string fields_param = req->query("fields");
+        if (!fields_param.empty()) {
+            fields = 0;
+            std::stringstream ss(fields_param);
+            std::string name;
+            while (std::getline(ss, name, ',')) {
+                if (name == "title") fields |= SearchEngine::FieldTitle;
+                else if (name == "link") fields |= SearchEngine::FieldLink;
+                else if (name == "summary") fields |= SearchEngine::FieldSummary;
             }
         }
         
-        // 3. 按分数排序并取topK
-        std::sort(all_results.begin(), all_results.end(),
-                  [](const SearchResult &a, const SearchResult &b) {
-                      return a.score > b.score;
-                  });
-        
-        if (all_results.size() > static_cast<size_t>(topK)) {
-            all_results.resize(topK);
+        // 执行搜索：基础索引与动态写入在引擎内统一打分取 top-k。
+        // 完整字段时直接引用缓存中的共享结果集及其预序列化 JSON，不拷贝；
+        // 部分字段时只物化最终的 top-k 并跳过未请求字段的生成
+        ResultSetPtr result_set;
+        std::vector<std::string> field_json;
+        const std::vector<std::string> *items = &field_json;
+        size_t count = 0;
+        if (g_engine && fields == SearchEngine::FieldAll) {
+            result_set = g_engine->queryRankedShared(terms, static_cast<size_t>(topK));
+            count = std::min(result_set->results.size(), static_cast<size_t>(topK));
+            items = &result_set->json;
+        } else if (g_engine) {
+            auto results = g_engine->queryRankedFields(terms, static_cast<size_t>(topK), fields);
+            count = results.size();
+            field_json.reserve(count);
+            for (const auto &r : results) {
+                field_json.push_back(ResultSet::serialize(r, fields));
+            }
         }
         
-        // 构建 JSON 响应
+        // 构建 JSON 响应：结果部分直接拼接预序列化的片段
         response["query"] = query;
-        response["count"] = all_results.size();
-        response["results"] = json::array();
+        response["count"] = count;
         response["sources"] = json::object();
         response["sources"]["static_index"] = g_engine != nullptr;
         response["sources"]["dynamic_index"] = g_dynamic_index != nullptr;
         
-        for (const auto &r : all_results) {
-            json item;
-            item["docid"] = r.docid;
-            item["score"] = r.score;
-            item["title"] = cleanUtf8(r.title);
-            item["link"] = cleanUtf8(r.link);
-            item["summary"] = cleanUtf8(r.summary);
-            response["results"].push_back(item);
+        std::string body = response.dump();
+        body.pop_back();  // 去掉结尾的 '}'
+        size_t reserve = body.size() + 16;
+        for (size_t i = 0; i < count; ++i) reserve += (*items)[i].size() + 1;
+        body.reserve(reserve);
+        body += ",\"results\":[";
+        for (size_t i = 0; i < count; ++i) {
+            if (i > 0) body.push_back(',');
+            body += (*items)[i];
         }
+        body += "]}";
         
-        resp->String(response.dump());
+        resp->String(std::move(body));
     });
     
     // 缓存统计端点
@@ -261,19 +484,39 @@ int main(int argc, char **argv) {
             return;
         }
         
-        size_t local_hits, redis_hits, misses, local_size;
-        g_engine->getCacheStats(local_hits, redis_hits, misses, local_size);
+        auto stats = g_engine->cacheStats();
         
-        size_t total = local_hits + redis_hits + misses;
-        double hit_rate = total > 0 ? (double)(local_hits + redis_hits) / total * 100.0 : 0.0;
+        size_t hits = stats.local_hits + stats.shm_hits + stats.redis_hits;
+        size_t total = hits + stats.misses;
+        double hit_rate = total > 0 ? (double)hits / total * 100.0 : 0.0;
         
         response["enabled"] = config.enable_cache;
-        response["local_hits"] = local_hits;
-        response["redis_hits"] = redis_hits;
-        response["misses"] = misses;
+        response["local_hits"] = stats.local_hits;
+        response["shm_hits"] = stats.shm_hits;
+        response["redis_hits"] = stats.redis_hits;
+        response["misses"] = stats.misses;
         response["total_requests"] = total;
         response["hit_rate"] = hit_rate;
-        response["local_cache_size"] = local_size;
+        response["local_cache_size"] = stats.local_size;
+        response["local_cache_bytes"] = stats.local_bytes;
+        response["local_cache_cold"] = stats.local_cold;
+        response["negative_hits"] = stats.negative_hits;
+        response["stale_hits"] = stats.stale_hits;
+        response["refreshes"] = stats.refreshes;
+        response["redis"] = {
+            {"errors", stats.redis_errors},
+            {"rejected", stats.redis_rejected},
+            {"dropped_puts", stats.redis_dropped_puts},
+            {"breaker_open", stats.redis_breaker_open}
+        };
+        
+        size_t coalesce_total = stats.coalesce_leaders + stats.coalesced;
+        response["coalescing"] = {
+            {"leaders", stats.coalesce_leaders},
+            {"coalesced", stats.coalesced},
+            {"timeouts", stats.coalesce_timeouts},
+            {"coalesce_rate", coalesce_total > 0 ? (double)stats.coalesced / coalesce_total * 100.0 : 0.0}
+        };
         
         resp->String(response.dump());
     });
@@ -308,7 +551,7 @@ int main(int argc, char **argv) {
         
         json response;
         
-        if (!g_dynamic_index) {
+        if (!g_ingest) {
             response["success"] = false;
             response["error"] = "Dynamic index not available";
             resp->String(response.dump());
@@ -325,26 +568,22 @@ int main(int argc, char **argv) {
                 return;
             }
             
-            int docid = body["docid"];
-            
-            // 检查是否提供了完整元数据
-            if (body.contains("title") || body.contains("link")) {
-                DynamicInvertedIndex::DocumentMeta meta;
-                meta.title = body.value("title", "");
-                meta.link = body.value("link", "");
-                meta.summary = body.value("summary", "");
-                meta.text = body["text"];
-                
-                g_dynamic_index->addDocument(docid, meta);
-            } else {
-                // 只有文本，使用简单接口
-                std::string text = body["text"];
-                g_dynamic_index->addDocument(docid, text);
+            std::string key;
+            uint32_t docid = 0;
+            if (!parseDocKey(body["docid"], key) || !g_doc_ids->assign(key, docid)) {
+                response["success"] = false;
+                response["error"] = "Invalid docid";
+                resp->String(response.dump());
+                return;
             }
             
-            response["success"] = true;
-            response["message"] = "Document added to index";
-            response["docid"] = docid;
+            // 分词与写入在后台完成，返回的序号可用于 /search?wait_for_seq=
+            IngestQueue::Request request;
+            request.docid = static_cast<int>(docid);
+            request.text = body["text"];
+            request.meta = parseDocumentMeta(body);
+            submitIngest({std::move(request)}, resp, response);
+            response["docid"] = body["docid"];
             
         } catch (const std::exception &e) {
             response["success"] = false;
@@ -361,7 +600,7 @@ int main(int argc, char **argv) {
         
         json response;
         
-        if (!g_dynamic_index) {
+        if (!g_ingest) {
             response["success"] = false;
             response["error"] = "Dynamic index not available";
             resp->String(response.dump());
@@ -369,12 +608,21 @@ int main(int argc, char **argv) {
         }
         
         try {
-            int docid = std::stoi(req->param("docid"));
-            g_dynamic_index->removeDocument(docid);
-            
-            response["success"] = true;
-            response["message"] = "Document removed from index";
-            response["docid"] = docid;
+            std::string key = req->param("docid");
+            uint32_t docid = 0;
+            if (!g_doc_ids->find(key, docid)) {
+                resp->set_status(HttpStatusNotFound);
+                response["success"] = false;
+                response["error"] = "Document not found";
+                response["docid"] = key;
+                resp->String(response.dump());
+                return;
+            }
+            IngestQueue::Request request;
+            request.docid = static_cast<int>(docid);
+            request.remove = true;
+            submitIngest({std::move(request)}, resp, response);
+            response["docid"] = key;
             
         } catch (const std::exception &e) {
             response["success"] = false;
@@ -391,7 +639,7 @@ int main(int argc, char **argv) {
         
         json response;
         
-        if (!g_dynamic_index) {
+        if (!g_ingest) {
             response["success"] = false;
             response["error"] = "Dynamic index not available";
             resp->String(response.dump());
@@ -399,7 +647,7 @@ int main(int argc, char **argv) {
         }
         
         try {
-            int docid = std::stoi(req->param("docid"));
+            std::string key = req->param("docid");
             json body = json::parse(req->body());
             
             if (!body.contains("text")) {
@@ -409,12 +657,20 @@ int main(int argc, char **argv) {
                 return;
             }
             
-            std::string text = body["text"];
-            g_dynamic_index->updateDocument(docid, text);
+            uint32_t docid = 0;
+            if (!g_doc_ids->assign(key, docid)) {
+                response["success"] = false;
+                response["error"] = "Invalid docid";
+                resp->String(response.dump());
+                return;
+            }
             
-            response["success"] = true;
-            response["message"] = "Document updated in index";
-            response["docid"] = docid;
+            // 写入会替换旧版本
+            IngestQueue::Request request;
+            request.docid = static_cast<int>(docid);
+            request.text = body["text"];
+            submitIngest({std::move(request)}, resp, response);
+            response["docid"] = key;
             
         } catch (const std::exception &e) {
             response["success"] = false;
@@ -431,7 +687,7 @@ int main(int argc, char **argv) {
         
         json response;
         
-        if (!g_dynamic_index) {
+        if (!g_ingest) {
             response["success"] = false;
             response["error"] = "Dynamic index not available";
             resp->String(response.dump());
@@ -448,36 +704,82 @@ int main(int argc, char **argv) {
                 return;
             }
             
-            int added_count = 0;
+            // 整批入队，由写线程合并为微批次应用（一次发布、一次落盘）
+            std::vector<IngestQueue::Request> requests;
+            std::vector<std::string> keys;
             for (const auto &doc : body["documents"]) {
-                if (!doc.contains("docid") || !doc.contains("text")) {
+                std::string key;
+                if (!doc.contains("docid") || !doc.contains("text") || !parseDocKey(doc["docid"], key)) {
                     continue;
                 }
                 
-                int docid = doc["docid"];
-                
-                // 检查是否有完整元数据
-                if (doc.contains("title") || doc.contains("link")) {
-                    DynamicInvertedIndex::DocumentMeta meta;
-                    meta.title = doc.value("title", "");
-                    meta.link = doc.value("link", "");
-                    meta.summary = doc.value("summary", "");
-                    meta.text = doc["text"];
-                    
-                    g_dynamic_index->addDocument(docid, meta);
-                } else {
-                    // 只有文本，使用简单接口
-                    g_dynamic_index->addDocument(docid, doc["text"].get<std::string>());
-                }
-                added_count++;
+                IngestQueue::Request request;
+                request.text = doc["text"];
+                request.meta = parseDocumentMeta(doc);
+                requests.push_back(std::move(request));
+                keys.push_back(std::move(key));
+            }
+            
+            // 整批新 ID 只落盘一次
+            std::vector<uint32_t> ids;
+            if (!g_doc_ids->assign(keys, ids)) {
+                response["success"] = false;
+                response["error"] = "Invalid docid";
+                resp->String(response.dump());
+                return;
+            }
+            for (size_t i = 0; i < requests.size(); ++i) {
+                requests[i].docid = static_cast<int>(ids[i]);
             }
             
-            // 不再调用addDocuments，因为它不支持元数据
-            // g_dynamic_index->addDocuments(documents);
+            size_t count = requests.size();
+            if (count > 0) {
+                submitIngest(std::move(requests), resp, response);
+            } else {
+                response["success"] = true;
+            }
+            response["count"] = count;
             
+        } catch (const std::exception &e) {
+            response["success"] = false;
+            response["error"] = std::string("Exception: ") + e.what();
+        }
+        
+        resp->String(response.dump());
+    });
+    
+    // GET /index/status/{seq} - 写入请求的处理结果：是否已应用、已落盘、因近重复被丢弃
+    server.GET("/index/status/:seq", [](const HttpReq *req, HttpResp *resp) {
+        resp->headers["Content-Type"] = "application/json";
+        resp->headers["Access-Control-Allow-Origin"] = "*";
+        
+        json response;
+        
+        if (!g_ingest) {
+            response["success"] = false;
+            response["error"] = "Dynamic index not available";
+            resp->String(response.dump());
+            return;
+        }
+        
+        try {
+            uint64_t seq = std::stoull(req->param("seq"));
+            auto stats = g_ingest->getStats();
+            if (seq == 0 || seq > stats.submitted_seq) {
+                resp->set_status(HttpStatusNotFound);
+                response["success"] = false;
+                response["error"] = "Unknown seq";
+                resp->String(response.dump());
+                return;
+            }
             response["success"] = true;
-            response["message"] = "Documents added to index";
-            response["count"] = added_count;
+            response["seq"] = seq;
+            response["applied"] = seq <= stats.applied_seq;
+            response["durable"] = seq <= stats.durable_seq;
+            int duplicate_of = -1;
+            bool rejected = g_ingest->rejection(seq, duplicate_of);
+            response["rejected"] = rejected;
+            if (rejected) response["duplicate_of"] = g_doc_ids->key(static_cast<uint32_t>(duplicate_of));
             
         } catch (const std::exception &e) {
             response["success"] = false;
@@ -509,6 +811,71 @@ int main(int argc, char **argv) {
             response["active_docs"] = stats.active_docs;
             response["deleted_docs"] = stats.deleted_docs;
             response["total_terms"] = stats.total_terms;
+            response["pending_updates"] = stats.pending_updates;
+            response["segments"] = stats.segments;
+            response["partitions"] = stats.partitions;
+            response["merges"] = stats.merges;
+            response["merging"] = stats.merging;
+            if (stats.merging) {
+                response["merge_progress"] = stats.merge_total > 0
+                    ? static_cast<double>(stats.merge_done) / stats.merge_total : 1.0;
+            }
+            response["storage"] = {
+                {"doc_records", stats.doc_records},
+                {"doc_store_bytes", stats.doc_store_bytes},
+                {"doc_dead_bytes", stats.doc_dead_bytes},
+                {"token_bytes", stats.token_bytes},
+                {"dict_terms", stats.dict_terms},
+                {"memory_saved_bytes", stats.memory_saved}
+            };
+            if (g_wal) {
+                auto wal = g_wal->getStats();
+                response["wal"] = {
+                    {"records", wal.appended},
+                    {"syncs", wal.syncs},
+                    {"bytes", wal.bytes},
+                    {"durable_lsn", wal.durable_lsn},
+                    {"failed", wal.failed},
+                    {"generation", g_wal->generation()},
+                    {"checkpoint_bytes", stats.checkpoint_bytes},
+                    {"checkpoint_ms", stats.checkpoint_ms}
+                };
+            }
+            response["docid_map"] = {
+                {"base_ids", g_doc_ids->baseLimit()},
+                {"assigned_ids", g_doc_ids->size() - g_doc_ids->baseLimit()}
+            };
+            if (g_ingest) {
+                auto ingest = g_ingest->getStats();
+                response["ingest"] = {
+                    {"submitted_seq", ingest.submitted_seq},
+                    {"applied_seq", ingest.applied_seq},
+                    {"durable_seq", ingest.durable_seq},
+                    {"durable_failures", ingest.durable_failures},
+                    {"pending", ingest.pending},
+                    {"batches", ingest.batches}
+                };
+            }
+            if (g_dedup) {
+                auto dedup = g_dedup->getStats();
+                response["dedup"] = {
+                    {"signatures", dedup.signatures},
+                    {"checked", dedup.checked},
+                    {"rejected", dedup.rejected},
+                    {"replaced", dedup.replaced}
+                };
+            }
+            if (g_feed) {
+                auto feed = g_feed->getStats();
+                response["feed"] = {
+                    {"offset", feed.offset},
+                    {"applied_offset", feed.applied_offset},
+                    {"lag_bytes", feed.file_bytes > feed.offset ? feed.file_bytes - feed.offset : 0},
+                    {"records", feed.records},
+                    {"errors", feed.errors},
+                    {"throttled", feed.throttled}
+                };
+            }
             response["needs_compaction"] = g_dynamic_index->needsCompaction();
             
         } catch (const std::exception &e) {
@@ -518,7 +885,7 @@ int main(int argc, char **argv) {
         resp->String(response.dump());
     });
     
-    // POST /index/compact - 压缩索引（清理已删除文档）
+    // POST /index/compact - 压缩索引（清理已删除文档），后台执行，进度见 /index/stats
     server.POST("/index/compact", [](const HttpReq *req, HttpResp *resp) {
         resp->headers["Content-Type"] = "application/json";
         resp->headers["Access-Control-Allow-Origin"] = "*";
@@ -533,14 +900,14 @@ int main(int argc, char **argv) {
         }
         
         try {
-            auto stats_before = g_dynamic_index->getStats();
-            g_dynamic_index->compact();
-            auto stats_after = g_dynamic_index->getStats();
+            auto stats = g_dynamic_index->getStats();
+            g_dynamic_index->requestCompaction();
             
+            resp->set_status(HttpStatusAccepted);
             response["success"] = true;
-            response["message"] = "Index compacted successfully";
-            response["docs_removed"] = stats_before.deleted_docs;
-            response["active_docs"] = stats_after.active_docs;
+            response["message"] = "Compaction scheduled";
+            response["deleted_docs"] = stats.deleted_docs;
+            response["active_docs"] = stats.active_docs;
             
         } catch (const std::exception &e) {
             response["success"] = false;
@@ -550,7 +917,7 @@ int main(int argc, char **argv) {
         resp->String(response.dump());
     });
     
-    // POST /index/save - 持久化索引到文件
+    // POST /index/save - 持久化：启用 WAL 时做检查点，否则导出索引文件
     server.POST("/index/save", [&config](const HttpReq *req, HttpResp *resp) {
         resp->headers["Content-Type"] = "application/json";
         resp->headers["Access-Control-Allow-Origin"] = "*";
@@ -564,6 +931,24 @@ int main(int argc, char **argv) {
             return;
         }
         
+        if (g_wal) {
+            uint64_t bytes_before = g_wal->sizeBytes();
+            if (g_dynamic_index->checkpoint()) {
+                response["success"] = true;
+                response["message"] = "Checkpoint written";
+                response["wal_bytes_before"] = bytes_before;
+                response["wal_bytes_after"] = g_wal->sizeBytes();
+                auto stats = g_dynamic_index->getStats();
+                response["checkpoint_bytes"] = stats.checkpoint_bytes;
+                response["checkpoint_ms"] = stats.checkpoint_ms;
+            } else {
+                response["success"] = false;
+                response["error"] = "Checkpoint failed";
+            }
+            resp->String(response.dump());
+            return;
+        }
+        
         try {
             namespace fs = std::filesystem;
             std::string save_path = (fs::path(config.index_dir) / "index_updated.txt").string();
@@ -596,8 +981,19 @@ int main(int argc, char **argv) {
     }
     
     std::cout << "Search service stopped.\n";
+    delete g_warmer;
+    if (g_query_log && !g_query_log->save(config.query_log_path)) {
+        std::cerr << "⚠ Failed to save query log to " << config.query_log_path << "\n";
+    }
+    delete g_query_log;
+    // 先停止所有写者：排队的写入经变更回调失效缓存，需在 g_engine 之前完成
+    delete g_feed;
+    delete g_ingest;  // 应用完已接受的写入
+    delete g_dedup;
+    delete g_dynamic_index;  // 先停止合并线程（可能正在检查点），再关闭 WAL
     delete g_engine;
-    delete g_dynamic_index;
+    delete g_wal;
+    delete g_doc_ids;
     return 0;
 }
 
@@ -0,0 +1,263 @@
+#include "shm_cache.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+namespace {
+    constexpr uint32_t kMagic = 0x53524333;  // "SRC3"（槽位增加写锁字与校验和）
+    constexpr uint32_t kStateEmpty = 0;
+    constexpr uint32_t kStateInit = 1;
+    constexpr uint32_t kStateReady = 2;
+
+    // 线性探测长度与读重试次数
+    constexpr size_t kProbe = 4;
+    constexpr int kReadRetries = 8;
+
+    // 写锁持有超过该时长视为持有者已崩溃或停住，其他写者可以收回（正常写入只是一次内存拷贝）
+    constexpr uint64_t kLockTimeoutMs = 1000;
+
+    // FNV-1a：不同进程、不同构建之间结果一致（std::hash 不保证）
+    inline uint64_t hashKey(std::string_view key) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h ? h : 1;  // 0 表示空槽位
+    }
+
+    // 槽位内容的校验和（按 8 字节分组混合，读路径上的开销约为一次拷贝）：
+    // 写锁被收回后原写者若继续写，槽位会是两次写入的混合，序号却已是偶数，只能靠它识别
+    inline uint64_t entryChecksum(uint64_t hash, uint64_t expire, std::string_view key, std::string_view value) {
+        uint64_t h = hash ^ (expire * 0x9E3779B97F4A7C15ULL) ^ (key.size() << 32 | value.size());
+        auto mix = [&h](uint64_t w) {
+            h ^= w;
+            h *= 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 29;
+        };
+        for (std::string_view part : {key, value}) {
+            size_t i = 0;
+            for (; i + 8 <= part.size(); i += 8) {
+                uint64_t w;
+                std::memcpy(&w, part.data() + i, 8);
+                mix(w);
+            }
+            uint64_t tail = 0;
+            if (i < part.size()) std::memcpy(&tail, part.data() + i, part.size() - i);
+            mix(tail ^ part.size());
+        }
+        return h;
+    }
+
+    // 墙钟毫秒：各进程共享同一时间基准
+    inline uint64_t nowMs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    // 单调时钟毫秒（CLOCK_MONOTONIC 在同一主机的各进程间一致，不受对时影响），+1 保证非零
+    inline uint64_t monotonicMs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count()) + 1;
+    }
+}
+
+struct ShmResultCache::Header {
+    std::atomic<uint32_t> state;
+    uint32_t magic;
+    uint64_t slots;
+    uint64_t slot_bytes;
+};
+
+struct ShmResultCache::Slot {
+    std::atomic<uint64_t> seq;   // 奇数表示正在写
+    std::atomic<uint64_t> lock;  // 写锁：0 表示空闲，否则为加锁时的单调时钟毫秒
+    uint64_t hash;               // 0 表示空
+    uint64_t expire_at_ms;
+    uint64_t checksum;           // entryChecksum(hash, expire_at_ms, key, value)
+    uint32_t key_len;
+    uint32_t value_len;
+    char data[1];                // key 后紧跟 value
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared seqlock needs lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared header needs lock-free 32-bit atomics");
+
+ShmResultCache::ShmResultCache(const Options &opts) : opts_(opts) {
+    const size_t header_bytes = 64;  // 槽位按缓存行对齐
+    opts_.slot_bytes = (std::max(opts_.slot_bytes, offsetof(Slot, data) + 64) + 63) / 64 * 64;
+    if (opts_.slots == 0) return;
+    mapped_size_ = header_bytes + opts_.slots * opts_.slot_bytes;
+
+    int fd = shm_open(opts_.name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "shm_open(" << opts_.name << ") failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    // 新建的区域由内核清零；已存在时大小不同说明配置不一致，放弃使用
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (st.st_size != 0 && static_cast<size_t>(st.st_size) != mapped_size_) ||
+        (st.st_size == 0 && ftruncate(fd, static_cast<off_t>(mapped_size_)) != 0)) {
+        std::cerr << "Shared memory cache " << opts_.name << " has mismatched size, disabled" << std::endl;
+        close(fd);
+        return;
+    }
+    void *p = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "mmap shared memory cache failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    // 第一个进程负责写头部，其余进程等待其完成
+    Header *h = static_cast<Header*>(p);
+    uint32_t expected = kStateEmpty;
+    if (h->state.compare_exchange_strong(expected, kStateInit)) {
+        h->magic = kMagic;
+        h->slots = opts_.slots;
+        h->slot_bytes = opts_.slot_bytes;
+        h->state.store(kStateReady, std::memory_order_release);
+    } else {
+        for (int i = 0; i < 1000 && h->state.load(std::memory_order_acquire) != kStateReady; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    if (h->state.load(std::memory_order_acquire) != kStateReady || h->magic != kMagic ||
+        h->slots != opts_.slots || h->slot_bytes != opts_.slot_bytes) {
+        std::cerr << "Shared memory cache " << opts_.name << " layout mismatch, disabled" << std::endl;
+        munmap(p, mapped_size_);
+        return;
+    }
+
+    base_ = p;
+    header_ = h;
+}
+
+ShmResultCache::~ShmResultCache() {
+    // 只解除映射，不 shm_unlink：其他进程仍在使用，重启后可继续命中
+    if (base_) munmap(base_, mapped_size_);
+}
+
+ShmResultCache::Slot *ShmResultCache::slotAt(size_t index) const {
+    return reinterpret_cast<Slot*>(static_cast<char*>(base_) + 64 + index * opts_.slot_bytes);
+}
+
+uint64_t ShmResultCache::lockSlot(Slot *slot) {
+    const uint64_t now = monotonicMs();
+    uint64_t held = slot->lock.load(std::memory_order_relaxed);
+    // 持有者写到一半被杀死时锁不会释放：超时后收回，否则放弃（缓存尽力而为）
+    if (held != 0 && now <= held + kLockTimeoutMs) return 0;
+    if (!slot->lock.compare_exchange_strong(held, now, std::memory_order_acquire)) return 0;
+
+    // 收回的槽位序号可能停在奇数（内容不完整），保持奇数直到重新写完
+    uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+    if (!(seq & 1)) slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return now;
+}
+
+void ShmResultCache::unlockSlot(Slot *slot, uint64_t token) {
+    // 停住太久、锁已被收回：由收回者发布，这里不再改动序号。
+    // 此时本写者在收回之后的写入可能已与收回者的写入交错，而序号为偶数、读者无从察觉；
+    // 保证的是不返回这样的混合内容：get 校验 checksum，不符按未命中处理，直到该槽位被重写
+    if (slot->lock.load(std::memory_order_relaxed) != token) return;
+    slot->seq.store((slot->seq.load(std::memory_order_relaxed) | 1) + 1, std::memory_order_release);
+    slot->lock.compare_exchange_strong(token, 0, std::memory_order_release);
+}
+
+size_t ShmResultCache::capacity() const {
+    return opts_.slot_bytes - offsetof(Slot, data);
+}
+
+bool ShmResultCache::get(std::string_view key, std::string &value) const {
+    if (!base_) return false;
+    const uint64_t hash = hashKey(key);
+    const uint64_t now = nowMs();
+
+    for (size_t i = 0; i < kProbe; ++i) {
+        const Slot *slot = slotAt((hash + i) % opts_.slots);
+        for (int attempt = 0; attempt < kReadRetries; ++attempt) {
+            uint64_t s1 = slot->seq.load(std::memory_order_acquire);
+            if (s1 & 1) continue;  // 正在写
+
+            uint64_t slot_hash = slot->hash;
+            uint64_t expire = slot->expire_at_ms;
+            uint64_t checksum = slot->checksum;
+            uint32_t key_len = slot->key_len;
+            uint32_t value_len = slot->value_len;
+            bool match = slot_hash == hash && key_len == key.size() &&
+                         static_cast<size_t>(key_len) + value_len <= capacity() &&
+                         std::memcmp(slot->data, key.data(), key_len) == 0;
+            if (match) value.assign(slot->data + key_len, value_len);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) != s1) continue;  // 读到一半被改写
+
+            // 序号一致但内容是两次写入的混合（见 unlockSlot）：按未命中处理
+            if (match) return entryChecksum(hash, expire, key, value) == checksum && expire > now;
+            break;  // 一致地读到其他 key，探测下一个槽位
+        }
+    }
+    return false;
+}
+
+bool ShmResultCache::put(std::string_view key, std::string_view value, uint64_t ttl_ms) {
+    if (!base_ || key.size() + value.size() > capacity()) return false;
+    const uint64_t hash = hashKey(key);
+    const uint64_t now = nowMs();
+
+    // 选槽位：同 key > 空槽或已过期 > 最早过期
+    Slot *target = nullptr;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < kProbe; ++i) {
+        Slot *slot = slotAt((hash + i) % opts_.slots);
+        uint64_t slot_hash = slot->hash;
+        uint64_t expire = slot->expire_at_ms;
+        if (slot_hash == hash) {
+            target = slot;
+            break;
+        }
+        if (slot_hash == 0 || expire <= now) {
+            if (oldest != 0) {
+                target = slot;
+                oldest = 0;
+            }
+        } else if (expire < oldest) {
+            target = slot;
+            oldest = expire;
+        }
+    }
+
+    uint64_t token = lockSlot(target);
+    if (!token) return false;
+    target->hash = hash;
+    target->expire_at_ms = now + ttl_ms;
+    target->checksum = entryChecksum(hash, now + ttl_ms, key, value);
+    target->key_len = static_cast<uint32_t>(key.size());
+    target->value_len = static_cast<uint32_t>(value.size());
+    std::memcpy(target->data, key.data(), key.size());
+    std::memcpy(target->data + key.size(), value.data(), value.size());
+    unlockSlot(target, token);
+    return true;
+}
+
+void ShmResultCache::clear() {
+    if (!base_) return;
+    for (size_t i = 0; i < opts_.slots; ++i) {
+        Slot *slot = slotAt(i);
+        uint64_t token = lockSlot(slot);
+        if (!token) continue;
+        slot->hash = 0;
+        slot->expire_at_ms = 0;
+        unlockSlot(slot, token);
+    }
+}
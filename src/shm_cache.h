@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// 跨进程共享内存结果缓存（同一主机上的多个 search_service 共享）
+//
+// - shm_open 映射的固定槽位哈希表，每个槽位保存一个 key 与编码后的值
+// - 读无锁：seqlock，读前后序号一致且为偶数才算有效，否则重试
+// - 写为 try-lock：槽位写锁字由 0 CAS 为加锁时刻，抢不到直接放弃（缓存尽力而为）；
+//   持有中序号为奇数。写者崩溃留下的锁超过 1 秒后由其他写者收回并重写该槽位
+// - 槽位保存内容校验和：被收回锁的写者恢复后写出的混合内容不会被读出（按未命中处理）
+// - 线性探测 kProbe 个槽位；都被占用时覆盖最早过期的一个
+// - 值超过槽位容量时不写入
+class ShmResultCache {
+public:
+    struct Options {
+        std::string name = "/search_result_cache";  // shm_open 名称
+        size_t slots = 16384;                       // 槽位数
+        size_t slot_bytes = 16384;                  // 单槽位字节数（含槽头）
+    };
+
+    explicit ShmResultCache(const Options &opts);
+    ~ShmResultCache();
+
+    ShmResultCache(const ShmResultCache&) = delete;
+    ShmResultCache& operator=(const ShmResultCache&) = delete;
+
+    // 映射是否成功（失败时 get/put 均为空操作）
+    bool ok() const { return base_ != nullptr; }
+
+    // 命中且未过期时把值拷贝到 value
+    bool get(std::string_view key, std::string &value) const;
+
+    // 写入；ttl_ms 后过期
+    bool put(std::string_view key, std::string_view value, uint64_t ttl_ms);
+
+    // 清空全部槽位
+    void clear();
+
+private:
+    struct Header;
+    struct Slot;
+
+    Slot *slotAt(size_t index) const;
+    // 加写锁，返回锁标识（失败为 0）；unlockSlot 发布写入并释放
+    static uint64_t lockSlot(Slot *slot);
+    static void unlockSlot(Slot *slot, uint64_t token);
+    size_t capacity() const;
+
+    Options opts_;
+    void *base_ = nullptr;
+    size_t mapped_size_ = 0;
+    Header *header_ = nullptr;
+};
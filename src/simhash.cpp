@@ -2,15 +2,21 @@
 #include <array>
 #include <functional>
 
-static inline uint64_t hashToken(const std::string &s) {
+uint64_t SimHasher::tokenHash(const std::string &token) {
     // 使用 std::hash 作为示例，可改为 MurmurHash/CityHash
-    return std::hash<std::string>{}(s);
+    return std::hash<std::string>{}(token);
 }
 
 uint64_t SimHasher::simhash64(const std::vector<std::string> &tokens) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(tokens.size());
+    for (const auto &t : tokens) hashes.push_back(tokenHash(t));
+    return simhash64(hashes);
+}
+
+uint64_t SimHasher::simhash64(const std::vector<uint64_t> &hashes) {
     std::array<long long, 64> bits{};
-    for (const auto &t : tokens) {
-        uint64_t h = hashToken(t);
+    for (uint64_t h : hashes) {
         for (int i = 0; i < 64; ++i) {
             bits[i] += (h & (1ULL << i)) ? 1 : -1;
         }
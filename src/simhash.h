@@ -10,7 +10,8 @@
 class SimHasher {
 public:
     static uint64_t simhash64(const std::vector<std::string> &tokens);
+    // 由已计算好的 token 哈希得到签名（同一 token 的哈希可在多篇文档间复用）
+    static uint64_t simhash64(const std::vector<uint64_t> &hashes);
+    static uint64_t tokenHash(const std::string &token);
     static int hammingDistance(uint64_t a, uint64_t b);
 };
-
-
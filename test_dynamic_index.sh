@@ -15,14 +15,17 @@ echo ""
 
 # 2. 添加单个文档
 echo "➕ 2. 添加新文档 (docid=99999)"
-curl -s -X POST "$BASE_URL/index/add" \
+ADD_RESP=$(curl -s -X POST "$BASE_URL/index/add" \
   -H "Content-Type: application/json" \
-  -d '{"docid": 99999, "text": "深度学习是人工智能的重要分支，包括神经网络、卷积网络等技术"}' | python3 -m json.tool
+  -d '{"docid": 99999, "text": "深度学习是人工智能的重要分支，包括神经网络、卷积网络等技术"}')
+echo "$ADD_RESP" | python3 -m json.tool
+# 写入异步应用（202），搜索时带上返回的序号等待其可见
+SEQ=$(echo "$ADD_RESP" | python3 -c "import sys, json; print(json.load(sys.stdin).get('seq', 0))")
 echo ""
 
 # 3. 搜索新文档
 echo "🔍 3. 搜索'人工智能'（应该包含新文档）"
-curl -s "$BASE_URL/search?q=%E4%BA%BA%E5%B7%A5%E6%99%BA%E8%83%BD&topk=5" | python3 -c "
+curl -s "$BASE_URL/search?q=%E4%BA%BA%E5%B7%A5%E6%99%BA%E8%83%BD&topk=5&wait_for_seq=$SEQ" | python3 -c "
 import sys, json
 d = json.load(sys.stdin)
 print(f'找到 {d[\"count\"]} 个结果')
@@ -0,0 +1,242 @@
+// 动态索引持久化的恢复路径：检查点往返、跨代重放日志、日志尾部残缺、检查点损坏
+// 构建并运行：make test
+#include "dynamic_index.h"
+#include "index_wal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    int g_failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::cerr << "✗ " << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; \
+            g_failures++;                                                           \
+        }                                                                           \
+    } while (0)
+
+    std::string makeTempDir() {
+        char dir[] = "/tmp/index_recovery_XXXXXX";
+        if (!::mkdtemp(dir)) {
+            std::cerr << "✗ mkdtemp: " << std::strerror(errno) << std::endl;
+            std::exit(1);
+        }
+        return dir;
+    }
+
+    void removeFiles(const std::string &wal) {
+        for (const char *suffix : {"", ".prev", ".tmp", ".ckpt", ".ckpt.tmp"}) {
+            ::unlink((wal + suffix).c_str());
+        }
+    }
+
+    std::string readFile(const std::string &path) {
+        std::ifstream fin(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string &path, const std::string &data) {
+        std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+        fout << data;
+    }
+
+    uint64_t fileSize(const std::string &path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    DynamicInvertedIndex::Update doc(int docid, const std::string &word) {
+        DynamicInvertedIndex::Update u;
+        u.docid = docid;
+        u.tokens = {word, "doc" + std::to_string(docid), "shared"};
+        auto meta = std::make_shared<DynamicInvertedIndex::DocumentMeta>();
+        meta->title = "title " + std::to_string(docid);
+        meta->link = "http://example.com/" + std::to_string(docid);
+        meta->summary = word;
+        u.meta = meta;
+        return u;
+    }
+
+    DynamicInvertedIndex::Update removal(int docid) {
+        DynamicInvertedIndex::Update u;
+        u.docid = docid;
+        u.remove = true;
+        return u;
+    }
+
+    // 一次“进程生命周期”：打开日志、恢复索引，执行 body 后按正常退出的顺序析构
+    template <typename Fn>
+    size_t session(const std::string &wal_path, size_t partitions, Fn &&body) {
+        IndexWal::Options wal_opts;
+        wal_opts.path = wal_path;
+        IndexWal wal(wal_opts);
+        if (!wal.open()) {
+            g_failures++;
+            return 0;
+        }
+        DynamicInvertedIndex::Options opts;
+        opts.partitions = partitions;
+        DynamicInvertedIndex index(opts);
+        size_t replayed = index.attachWal(&wal);
+        body(index, wal);
+        return replayed;
+    }
+
+    bool hasMeta(const DynamicInvertedIndex &index, int docid, const std::string &summary) {
+        DynamicInvertedIndex::DocumentMeta meta;
+        return index.getDocumentMeta(docid, meta) && meta.summary == summary &&
+               meta.title == "title " + std::to_string(docid);
+    }
+
+    // 检查点保存段、删除位图与元数据，重启后只需重放检查点之后的日志；分区数变化不影响
+    void testCheckpointRoundTrip(const std::string &dir) {
+        std::string wal = dir + "/roundtrip.wal";
+        session(wal, 2, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.applyBatch({doc(1, "apple"), doc(2, "banana"), doc(3, "cherry")}));
+            CHECK(index.applyBatch({removal(2), doc(4, "apple")}));
+            CHECK(index.checkpoint());
+            CHECK(index.applyBatch({doc(5, "apple")}));
+        });
+        CHECK(fileSize(wal + ".ckpt") > 0);
+        CHECK(fileSize(wal + ".prev") == 0);
+
+        for (size_t partitions : {2, 3}) {
+            size_t replayed = session(wal, partitions, [](DynamicInvertedIndex &index, IndexWal &) {
+                CHECK(index.contains(1) && index.contains(3) && index.contains(4) && index.contains(5));
+                CHECK(!index.contains(2));
+                CHECK(hasMeta(index, 1, "apple"));
+                CHECK(hasMeta(index, 4, "apple"));
+                CHECK(index.searchANDCosineRanked({"apple"}).size() == 3);
+                CHECK(index.searchANDCosineRanked({"banana"}).empty());
+            });
+            CHECK(replayed == 1);
+        }
+    }
+
+    // 检查点切换日志后、写完检查点文件前崩溃：上一代留在 <wal>.prev，
+    // 重启时从旧检查点出发，依次重放 .prev 与当前代
+    void testReplayAcrossGenerations(const std::string &dir) {
+        std::string wal = dir + "/generations.wal";
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &log) {
+            CHECK(index.applyBatch({doc(1, "apple"), doc(2, "banana")}));
+            CHECK(index.checkpoint());
+            CHECK(index.applyBatch({doc(3, "cherry"), removal(1)}));
+            CHECK(log.rotate() != 0);  // 模拟未完成的检查点
+            CHECK(index.applyBatch({doc(4, "apple"), doc(2, "grape")}));
+        });
+        CHECK(fileSize(wal + ".prev") > 0);
+
+        size_t replayed = session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(!index.contains(1));
+            CHECK(index.contains(2) && index.contains(3) && index.contains(4));
+            CHECK(hasMeta(index, 2, "grape"));
+            CHECK(index.searchANDCosineRanked({"banana"}).empty());
+            CHECK(index.searchANDCosineRanked({"apple"}).size() == 1);
+            // 下一个检查点覆盖两代日志
+            CHECK(index.checkpoint());
+        });
+        CHECK(replayed == 4);
+        CHECK(fileSize(wal + ".prev") == 0);
+
+        replayed = session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.contains(2) && index.contains(3) && index.contains(4) && !index.contains(1));
+        });
+        CHECK(replayed == 0);
+    }
+
+    // 崩溃时写了一半的尾部记录：重放到最后一条完整记录为止并截断，之后的追加照常可恢复
+    void testTornWalTail(const std::string &dir) {
+        std::string wal = dir + "/torn.wal";
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.applyBatch({doc(1, "apple")}));
+            CHECK(index.applyBatch({doc(2, "banana")}));
+        });
+        uint64_t complete = fileSize(wal);
+
+        // 再写一条，然后只保留它的一部分
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.applyBatch({doc(3, "cherry")}));
+        });
+        std::string data = readFile(wal);
+        CHECK(data.size() > complete + 8);
+        writeFile(wal, data.substr(0, complete + (data.size() - complete) / 2));
+
+        size_t replayed = session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.contains(1) && index.contains(2));
+            CHECK(!index.contains(3));
+            CHECK(index.applyBatch({doc(4, "apple")}));
+        });
+        CHECK(replayed == 2);
+
+        replayed = session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.contains(1) && index.contains(2) && index.contains(4));
+            CHECK(!index.contains(3));
+            CHECK(hasMeta(index, 4, "apple"));
+        });
+        CHECK(replayed == 3);
+    }
+
+    // 检查点正文被改动（长度与结束标记仍完好）：CRC 不符，整个检查点被忽略
+    void testCorruptCheckpoint(const std::string &dir) {
+        std::string wal = dir + "/corrupt.wal";
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.applyBatch({doc(1, "apple"), doc(2, "banana")}));
+            CHECK(index.checkpoint());
+            CHECK(index.applyBatch({doc(3, "cherry")}));
+        });
+
+        std::string ckpt = readFile(wal + ".ckpt");
+        CHECK(ckpt.size() > 64);
+        std::string tampered = ckpt;
+        tampered[tampered.size() / 2] ^= 0x01;
+        writeFile(wal + ".ckpt", tampered);
+
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(!index.contains(1) && !index.contains(2));
+            CHECK(index.contains(3));
+        });
+
+        // 原样写回后可以正常加载
+        writeFile(wal + ".ckpt", ckpt);
+        session(wal, 1, [](DynamicInvertedIndex &index, IndexWal &) {
+            CHECK(index.contains(1) && index.contains(2) && index.contains(3));
+            CHECK(hasMeta(index, 2, "banana"));
+        });
+    }
+}
+
+int main() {
+    std::string dir = makeTempDir();
+    struct Case {
+        const char *name;
+        void (*run)(const std::string &);
+    };
+    const Case cases[] = {
+        {"checkpoint round trip", testCheckpointRoundTrip},
+        {"replay across WAL generations", testReplayAcrossGenerations},
+        {"torn WAL tail", testTornWalTail},
+        {"corrupt checkpoint", testCorruptCheckpoint},
+    };
+    for (const auto &c : cases) {
+        int before = g_failures;
+        c.run(dir);
+        std::cout << (g_failures == before ? "✓ " : "✗ ") << c.name << std::endl;
+    }
+
+    for (const char *name : {"roundtrip.wal", "generations.wal", "torn.wal", "corrupt.wal"}) {
+        removeFiles(dir + "/" + name);
+    }
+    ::rmdir(dir.c_str());
+    return g_failures == 0 ? 0 : 1;
+}